@@ -3,7 +3,16 @@
 #include "stdafx.h"
 #include "DualScreenWin32.h"
 #include "ScreenInfo.h"
+#include "LayoutTree.h"
+#include "WindowGeometry.h"
+#include "LayoutSubscriptions.h"
+#include "LatencyHarness.h"
+#include "SharedLayout.h"
+#include "TiledRenderer.h"
+#include "TextFlow.h"
+#include "LayoutHistory.h"
 #include <string>
+#include <vector>
 
 #define MAX_LOADSTRING 100
 
@@ -13,10 +22,27 @@ const int TEXT_HEIGHT = 20;
 using namespace dual_screen;
 
 ScreenInfo screenInfo{};
+LayoutTree layoutTree{};
+LayoutTree::NodeId statusPane{ LayoutTree::InvalidNode };
+WindowGeometry windowGeometry{};
+LayoutSubscriptions layoutSubscriptions{};
+LatencyRecorder latencyRecorder{};
+LayoutHistory layoutHistory{};
+SharedLayoutPublisher sharedLayout{};
+TiledRenderer tiledRenderer{};
+bool parallelRendering{ false };
 HWND hwnd;
 HWND textWnd;
 HFONT font;
 
+// The document view flows a long document across all the regions; text is measured
+// with 'font' selected into an off-screen DC.
+HDC measureDc;
+int MeasureText(void* context, const wchar_t* text, int length);
+TextFlow textFlow{ MeasureText, &measureDc, FONT_SIZE };
+bool documentView{ false };
+unsigned int documentReflows{ 0 };  // Reflows that actually laid out any lines
+
 #pragma region Default project template stuff
 
 // Global Variables:
@@ -115,6 +141,15 @@ BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
     SetWindowTextW(textWnd, L"");
     SendMessage(textWnd, WM_SETFONT, (WPARAM)font, TRUE);
 
+    measureDc = CreateCompatibleDC(nullptr);
+    SelectObject(measureDc, font);
+
+    // The status text sits at the top of the "best" region, with the rest of that
+    // region left for content. It moves to whichever region is best in OnLayoutChanged.
+    statusPane = layoutTree.AddSplit(layoutTree.GetRegionRoot(0), SplitKind::Horizontal);
+    layoutTree.AddLeaf(statusPane, LayoutSize::Fixed(TEXT_HEIGHT), textWnd);
+    layoutTree.AddLeaf(statusPane, LayoutSize::Flex());
+
     ShowWindow(hWnd, nCmdShow);
     UpdateWindow(hWnd);
 
@@ -123,85 +158,572 @@ BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
 
 #pragma endregion
 
+// Each region is drawn as a box (leaving room for the status text in the "best" region)
+// with a description of the region inside it.
+RECT GetRegionBox(unsigned int index, int bestIndex)
+{
+    auto box{ screenInfo.GetRect(index) };
+    InflateRect(&box, -MARGIN, -MARGIN);
+
+    // Add space for the heading text if necessary (it's always drawn in the "best" rect)
+    if (static_cast<int>(index) == bestIndex)
+    {
+        box.top += TEXT_HEIGHT + MARGIN;
+    }
+
+    return box;
+}
+
+// Blue or yellow?
+COLORREF GetRegionFillColor(unsigned int index)
+{
+    return (index % 2) ? RGB(255, 255, 0) : RGB(0, 255, 255);
+}
+
+COLORREF GetRegionOutlineColor(unsigned int index)
+{
+    return (index % 2) ? RGB(128, 128, 0) : RGB(0, 128, 128);
+}
+
+// Keeps drawing for a masked region off the parts of its panel that can't be seen
+// (rounded corners, cutouts). Returns the state to pass to RestoreDC afterwards, or
+// 0 if the region is entirely usable and nothing was changed.
+int ClipToUsableArea(HDC hdc, unsigned int index)
+{
+    if (!screenInfo.HasRegionMask(index))
+    {
+        return 0;
+    }
+
+    auto state{ SaveDC(hdc) };
+    auto usable{ CreateRectRgn(0, 0, 0, 0) };
+    for (const auto& rect : screenInfo.GetRegionRects(index))
+    {
+        auto part{ CreateRectRgnIndirect(&rect) };
+        CombineRgn(usable, usable, part, RGN_OR);
+        DeleteObject(part);
+    }
+
+    ExtSelectClipRgn(hdc, usable, RGN_AND);
+    DeleteObject(usable);
+    return state;
+}
+
+void DrawRegionLabel(HDC hdc, unsigned int index, RECT box)
+{
+    auto thisRect{ screenInfo.GetRect(index) };
+
+    static wchar_t buffer[500];
+    swprintf_s(buffer, L"Rect %d, size: %d x %d\r\n(%d, %d) - (%d, %d)",
+        index, RectWidth(thisRect), RectHeight(thisRect),
+        thisRect.left, thisRect.top, thisRect.right, thisRect.bottom);
+
+    // Shrink again for another margin
+    InflateRect(&box, -MARGIN, -MARGIN);
+    DrawTextW(hdc, buffer, -1, &box, DT_CENTER);
+}
+
+int MeasureText(void* context, const wchar_t* text, int length)
+{
+    SIZE size{};
+    GetTextExtentPoint32W(*static_cast<HDC*>(context), text, length, &size);
+    return size.cx;
+}
+
+// A few thousand paragraphs of filler text, so that reflow cost is actually visible.
+std::vector<std::wstring> GenerateDocument(unsigned int paragraphCount)
+{
+    static const wchar_t* words[]{ L"lorem", L"ipsum", L"dolor", L"sit", L"amet", L"consectetur",
+        L"adipiscing", L"elit", L"sed", L"do", L"eiusmod", L"tempor", L"incididunt", L"ut", L"labore",
+        L"et", L"dolore", L"magna", L"aliqua", L"enim", L"ad", L"minim", L"veniam", L"quis", L"nostrud" };
+    const unsigned int wordCount{ ARRAYSIZE(words) };
+
+    std::vector<std::wstring> paragraphs(paragraphCount);
+    unsigned int seed{ 1 };
+    for (unsigned int i = 0; i < paragraphCount; ++i)
+    {
+        paragraphs[i] = std::to_wstring(i + 1) + L".";
+
+        // Anything from a heading-sized line to a long block of text.
+        seed = seed * 1103515245 + 12345;
+        auto length{ 3 + (seed >> 16) % 120 };
+        for (unsigned int j = 0; j < length; ++j)
+        {
+            seed = seed * 1103515245 + 12345;
+            paragraphs[i] += L' ';
+            paragraphs[i] += words[(seed >> 16) % wordCount];
+        }
+    }
+
+    return paragraphs;
+}
+
+// The document gets each region's box, less a margin for the text.
+void ReflowDocument(const ScreenInfo& info)
+{
+    if (textFlow.GetParagraphCount() == 0)
+    {
+        textFlow.SetParagraphs(GenerateDocument(5000));
+    }
+
+    auto bestIndex{ info.GetBestIndexForHorizontalContent() };
+
+    std::vector<RECT> regions;
+    for (unsigned int i = 0; i < info.GetRectCount(); ++i)
+    {
+        auto box{ GetRegionBox(i, bestIndex) };
+        InflateRect(&box, -MARGIN, -MARGIN);
+        regions.push_back(box);
+    }
+
+    textFlow.Reflow(regions);
+    if (textFlow.GetLastStats().linesPlaced > 0)
+    {
+        ++documentReflows;
+    }
+}
+
+void DrawDocumentRegion(HDC hdc, unsigned int index)
+{
+    unsigned int first{ 0 };
+    unsigned int count{ 0 };
+    textFlow.GetRegionLines(index, first, count);
+    if (count == 0)
+    {
+        return;
+    }
+
+    auto region{ textFlow.GetRegion(index) };
+    auto oldMode{ SetBkMode(hdc, TRANSPARENT) };
+
+    const auto& lines{ textFlow.GetLines() };
+    for (auto i = first; i < first + count; ++i)
+    {
+        const auto& line{ lines[i] };
+        const auto& text{ textFlow.GetParagraph(line.paragraph) };
+        ExtTextOutW(hdc, region.left, region.top + line.y, ETO_CLIPPED, &region, text.c_str() + line.start, line.length, nullptr);
+    }
+
+    SetBkMode(hdc, oldMode);
+}
+
+// Runs on a thread-pool thread; draws the same box as the GDI path, in software.
+// Everything the tiles need, worked out on the UI thread before they're drawn, so
+// the pool threads never look at screenInfo (which the UI thread owns).
+struct TilePaintContext
+{
+    COLORREF background;
+    std::vector<RECT> boxes;    // GetRegionBox for each region
+};
+
+void PaintRegionTile(void* context, unsigned int index, const RECT& tile, const PixelSurface& surface)
+{
+    const auto& paint{ *static_cast<const TilePaintContext*>(context) };
+    const auto& box{ paint.boxes[index] };
+
+    // A masked region is split over several tiles, so stay inside this one.
+    FillPixels(surface, tile, paint.background);
+    FillPixels(surface, box, GetRegionFillColor(index), tile);
+    FramePixels(surface, box, GetRegionOutlineColor(index), tile);
+}
+
+// Draws the regions in parallel into the off-screen frame, adds the text, and then
+// presents the whole thing with a single blit.
+void PaintTiled(HWND hWnd, HDC hdc, const RECT& dirty, int bestIndex)
+{
+    RECT client{};
+    ::GetClientRect(hWnd, &client);
+    if (!tiledRenderer.Resize(hdc, RectWidth(client), RectHeight(client)))
+    {
+        return;
+    }
+
+    TilePaintContext paint{ GetSysColor(COLOR_WINDOW) };
+    paint.boxes.reserve(screenInfo.GetRectCount());
+    for (unsigned int i = 0; i < screenInfo.GetRectCount(); ++i)
+    {
+        paint.boxes.push_back(GetRegionBox(i, bestIndex));
+    }
+
+    tiledRenderer.SetBackgroundColor(paint.background);
+    tiledRenderer.Render(screenInfo, PaintRegionTile, &paint);
+
+    // Text still goes through GDI, once all the tiles are done.
+    auto frameDc{ tiledRenderer.GetDC() };
+    auto oldFont{ SelectObject(frameDc, font) };
+    for (unsigned int i = 0; i < screenInfo.GetRectCount(); ++i)
+    {
+        auto state{ ClipToUsableArea(frameDc, i) };
+
+        if (documentView)
+        {
+            DrawDocumentRegion(frameDc, i);
+        }
+        else
+        {
+            DrawRegionLabel(frameDc, i, paint.boxes[i]);
+        }
+
+        if (state != 0)
+        {
+            RestoreDC(frameDc, state);
+        }
+    }
+    SelectObject(frameDc, oldFont);
+
+    tiledRenderer.Present(hdc, dirty);
+}
+
+// Called (once per layout generation) whenever the content regions materially change.
+void OnLayoutChanged(void* context, const ScreenInfo& info)
+{
+    auto hWnd{ static_cast<HWND>(context) };
+
+    // Nothing to lay out into (eg minimized).
+    if (info.GetRectCount() == 0)
+    {
+        return;
+    }
+
+    // Each content region has its own root in the layout tree. Figure out which screen
+    // has the most available space, and then move the simple status text to that screen
+    layoutTree.SetRegions(info, MARGIN);
+
+    // There may be no best region (eg every region is empty while minimized), and
+    // layout changes can arrive during CreateWindowW, before the status pane exists.
+    auto bestIndex{ info.GetBestIndexForHorizontalContent() };
+    if (bestIndex >= 0 && statusPane != LayoutTree::InvalidNode)
+    {
+        layoutTree.MoveNode(statusPane, layoutTree.GetRegionRoot(bestIndex));
+    }
+
+    // Only the regions from the first one that changed size get laid out again.
+    if (documentView)
+    {
+        ReflowDocument(info);
+    }
+
+    InvalidateRect(hWnd, nullptr, true);
+}
+
+// Lets helper processes (renderers, capture, etc.) see the new layout without
+// having to call GetContentRects themselves.
+void OnPublishSharedLayout(void* context, const ScreenInfo& info)
+{
+    static_cast<SharedLayoutPublisher*>(context)->Publish(info);
+}
+
+// Remembers every layout (and when it happened) for Tools > Dump layout history.
+void OnRecordLayoutHistory(void* context, const ScreenInfo& info)
+{
+    static_cast<LayoutHistory*>(context)->Record(info);
+}
+
+// Replays each synthetic event through the normal message handlers and then paints
+// synchronously, so every stage is measured the same way a real move would hit it.
+void RunLatencyScenario(HWND hWnd, const wchar_t* scenario, const std::vector<SyntheticEvent>& events)
+{
+    latencyRecorder.Start();
+
+    for (const auto& e : events)
+    {
+        LatencyRecorder::Scope timing{ latencyRecorder, LatencyStage::Total };
+
+        if (e.kind == SyntheticEvent::Kind::Geometry)
+        {
+            SetWindowPos(hWnd, nullptr, e.windowRect.left, e.windowRect.top,
+                RectWidth(e.windowRect), RectHeight(e.windowRect), SWP_NOZORDER | SWP_NOACTIVATE);
+        }
+        else if (e.kind == SyntheticEvent::Kind::Repaint)
+        {
+            InvalidateRect(hWnd, nullptr, FALSE);
+        }
+        else
+        {
+            screenInfo.EmulateScreens(e.emulatedScreens, e.splitKind);
+            SendMessage(hWnd, WM_SIZE, 0, 0);
+        }
+
+        RedrawWindow(hWnd, nullptr, nullptr, RDW_UPDATENOW | RDW_ALLCHILDREN);
+    }
+
+    latencyRecorder.Stop();
+    latencyRecorder.AppendCsv(L"latency.csv", scenario);
+}
+
+// Times the panel mask workload both ways; returns false if they disagree.
+bool RunMaskScenario(int width, int height, unsigned int iterations)
+{
+    auto workload{ MaskWorkload::ForPanel(width, height) };
+    MaskWorkloadResult spans{};
+    MaskWorkloadResult bitmap{};
+
+    wchar_t scenario[64];
+    swprintf_s(scenario, L"mask-spans-%dx%d", width, height);
+    latencyRecorder.Start();
+    for (unsigned int i = 0; i < iterations; ++i)
+    {
+        LatencyRecorder::Scope timing{ latencyRecorder, LatencyStage::Total };
+        spans = RunMaskWorkloadSpans(workload);
+    }
+    latencyRecorder.Stop();
+    latencyRecorder.AppendCsv(L"latency.csv", scenario);
+
+    swprintf_s(scenario, L"mask-bitmap-%dx%d", width, height);
+    latencyRecorder.Start();
+    for (unsigned int i = 0; i < iterations; ++i)
+    {
+        LatencyRecorder::Scope timing{ latencyRecorder, LatencyStage::Total };
+        bitmap = RunMaskWorkloadBitmap(workload);
+    }
+    latencyRecorder.Stop();
+    latencyRecorder.AppendCsv(L"latency.csv", scenario);
+
+    return spans.IsSameAs(bitmap);
+}
+
+void RunLatencyHarness(HWND hWnd)
+{
+    RECT original{};
+    ::GetWindowRect(hWnd, &original);
+
+    RECT desktop{ GetSystemMetrics(SM_XVIRTUALSCREEN), GetSystemMetrics(SM_YVIRTUALSCREEN) };
+    desktop.right = desktop.left + GetSystemMetrics(SM_CXVIRTUALSCREEN);
+    desktop.bottom = desktop.top + GetSystemMetrics(SM_CYVIRTUALSCREEN);
+
+    RunLatencyScenario(hWnd, L"drag", GenerateDrag(original, desktop, 200));
+
+    // Same drag again, but looking layouts up in the precomputed map.
+    bool usingLayoutMap{ screenInfo.IsUsingLayoutMap() };
+    screenInfo.UseLayoutMap(true);
+    RunLatencyScenario(hWnd, L"drag-map", GenerateDrag(original, desktop, 200));
+    screenInfo.UseLayoutMap(usingLayoutMap);
+
+    // Differential sweep of the layout map against GetContentRects itself, by moving
+    // the window around the real monitors (concentrating on the edges, where the
+    // layout changes shape).
+    auto sweepClients{ GenerateClientRects(ScreenInfo::GetMonitorRects(), screenInfo.GetMinRectSize(), 2000) };
+    auto sweepChecked{ static_cast<unsigned int>(sweepClients.size()) };
+    auto sweepMismatches{ CountLayoutMapMismatches(hWnd, screenInfo.GetMinRectSize(), sweepClients) };
+    SetWindowPos(hWnd, nullptr, original.left, original.top, RectWidth(original), RectHeight(original), SWP_NOZORDER | SWP_NOACTIVATE);
+    SendMessage(hWnd, WM_SIZE, 0, 0);
+
+    // Panel masks as spans vs a byte per pixel, on increasingly large panels.
+    unsigned int maskMismatches{ 0 };
+    for (const auto& panel : { SIZE{ 2560, 1600 }, SIZE{ 3840, 2160 }, SIZE{ 7680, 4320 } })
+    {
+        if (!RunMaskScenario(panel.cx, panel.cy, 20))
+        {
+            ++maskMismatches;
+        }
+    }
+
+    RunLatencyScenario(hWnd, L"resize", GenerateResizeStorm(original, 500, 100));
+    RunLatencyScenario(hWnd, L"hotplug", GenerateHotplugBurst(50));
+
+    // The same traces again with a large document flowing across the regions. The
+    // hotplug burst leaves a single emulated screen behind, so get rid of that first,
+    // and start with the window spanning the first two monitors so that the drag
+    // actually moves text from one region to the other.
+    screenInfo.EmulateScreens(0, SplitKind::None);
+    SetWindowPos(hWnd, nullptr, original.left, original.top, RectWidth(original), RectHeight(original), SWP_NOZORDER | SWP_NOACTIVATE);
+    SendMessage(hWnd, WM_SIZE, 0, 0);
+
+    auto spanned{ original };
+    auto monitors{ ScreenInfo::GetMonitorRects() };
+    bool canSpan{ monitors.size() > 1 };
+    if (canSpan)
+    {
+        RECT both{};
+        UnionRect(&both, &monitors[0], &monitors[1]);
+        OffsetRect(&spanned, (both.left + both.right - original.left - original.right) / 2,
+            (both.top + both.bottom - original.top - original.bottom) / 2);
+
+        SetWindowPos(hWnd, nullptr, spanned.left, spanned.top, RectWidth(spanned), RectHeight(spanned), SWP_NOZORDER | SWP_NOACTIVATE);
+        SendMessage(hWnd, WM_SIZE, 0, 0);
+    }
+
+    bool wasDocumentView{ documentView };
+    documentView = true;
+    ReflowDocument(screenInfo);
+
+    auto reflowsBefore{ documentReflows };
+    RunLatencyScenario(hWnd, L"reflow-drag", GenerateDrag(spanned, desktop, 200));
+    auto dragReflows{ documentReflows - reflowsBefore };
+
+    RunLatencyScenario(hWnd, L"reflow-resize", GenerateResizeStorm(spanned, 500, 100));
+    RunLatencyScenario(hWnd, L"reflow-hotplug", GenerateHotplugBurst(50));
+    documentView = wasDocumentView;
+
+    // Frame times for the tiled renderer, by region count and thread count.
+    bool wasParallelRendering{ parallelRendering };
+    parallelRendering = true;
+    for (auto threads : { 1u, 2u, 4u, 0u })
+    {
+        tiledRenderer.SetMaxThreads(threads);
+        for (auto regions : { 1, 2, 4, 8 })
+        {
+            screenInfo.EmulateScreens(regions, SplitKind::Vertical);
+            SendMessage(hWnd, WM_SIZE, 0, 0);
+
+            wchar_t scenario[64];
+            swprintf_s(scenario, L"tiled-r%d-t%u", regions, tiledRenderer.GetMaxThreads());
+            RunLatencyScenario(hWnd, scenario, GenerateRepaints(100));
+        }
+    }
+    tiledRenderer.SetMaxThreads(0);
+    parallelRendering = wasParallelRendering;
+
+    // Put everything back the way it was (minus any emulation).
+    screenInfo.EmulateScreens(0, SplitKind::None);
+    SetWindowPos(hWnd, nullptr, original.left, original.top, RectWidth(original), RectHeight(original), SWP_NOZORDER | SWP_NOACTIVATE);
+    SendMessage(hWnd, WM_SIZE, 0, 0);
+
+    // With only one monitor the drag never changes the layout, so no reflows are expected.
+    bool reflowMissing{ canSpan && dragReflows == 0 };
+
+    char message[300];
+    sprintf_s(message, "Results appended to latency.csv\n\nLayout map sweep: %u client rects, %u mismatches\n"
+        "Panel masks: %u mismatches\nReflow drag: %u reflows%s",
+        sweepChecked, sweepMismatches, maskMismatches, dragReflows, canSpan ? "" : " (single monitor)");
+    MessageBoxA(hWnd, message, "Latency test",
+        sweepMismatches + maskMismatches > 0 || reflowMissing ? MB_OK | MB_ICONERROR : MB_OK);
+}
+
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
     switch (message)
     {
+    case WM_CREATE:
+    {
+        layoutSubscriptions.Subscribe(LayoutChangeFilter::Any, OnLayoutChanged, hWnd);
+        layoutSubscriptions.Subscribe(LayoutChangeFilter::Any, OnRecordLayoutHistory, &layoutHistory);
+
+        // Not fatal if this fails; there just won't be anything for helpers to read.
+        if (sharedLayout.Create())
+        {
+            layoutSubscriptions.Subscribe(LayoutChangeFilter::Any, OnPublishSharedLayout, &sharedLayout);
+        }
+        break;
+    }
     case WM_SIZE:
     case WM_MOVE:
     {
-        // Any time we move or re-size, we refresh our view of the two screens and see which 
-        // one is the "best" one for displaying some content, and then repaint
+        // Any time we move or re-size, we refresh our view of the two screens; anyone
+        // who cares about material changes hears about them through layoutSubscriptions.
 
-        // Update returns true if things have materially changed. Note that we still want to
-        // update our text since that includes 'immaterial' things like the window rect.
-        auto needRedraw{ screenInfo.Update(hWnd) };
+        // Note that we still want to update our text even if nothing material changed
+        // since that includes 'immaterial' things like the window rect.
+        {
+            LatencyRecorder::Scope timing{ latencyRecorder, LatencyStage::Update };
+            screenInfo.Update(hWnd);
+        }
 
         // Update our status text for new info
-        static wchar_t buffer[500];
-        auto client{ screenInfo.GetClientRect() };
-        auto window{ screenInfo.GetWindowRect() };
+        {
+            LatencyRecorder::Scope timing{ latencyRecorder, LatencyStage::Format };
 
-        swprintf_s(buffer, L"%d rects%s, client:%dx%d, window:%dx%d@(%d,%d)", screenInfo.GetRectCount(),
-            screenInfo.IsEmulating() ? L" (emu)" : L"",
-            RectWidth(client), RectHeight(client),
-            RectWidth(window), RectHeight(window), window.left, window.top);
+            static wchar_t buffer[500];
+            auto client{ screenInfo.GetClientRect() };
+            auto window{ screenInfo.GetWindowRect() };
+
+            swprintf_s(buffer, L"%d rects%s, client:%dx%d, window:%dx%d@(%d,%d)", screenInfo.GetRectCount(),
+                screenInfo.IsEmulating() ? L" (emu)" : L"",
+                RectWidth(client), RectHeight(client),
+                RectWidth(window), RectHeight(window), window.left, window.top);
+
+            SetWindowText(textWnd, buffer);
+        }
 
-        SetWindowText(textWnd, buffer);
+        LatencyRecorder::Scope timing{ latencyRecorder, LatencyStage::Layout };
+        layoutSubscriptions.Publish(screenInfo);
 
-        if (needRedraw)
+        // Only the panes whose layout is dirty get recomputed, and only the windows
+        // that actually moved are touched - all in one batch.
+        if (layoutTree.Update())
         {
-            // Figure out which screen has the most available space, and then move the
-            // simple status text to that screen
-            auto bestScreen = screenInfo.GetRect(screenInfo.GetBestIndexForHorizontalContent());
-            InflateRect(&bestScreen, -MARGIN, -MARGIN);
-            MoveWindow(textWnd, bestScreen.left, bestScreen.top, RectWidth(bestScreen), TEXT_HEIGHT, TRUE);
+            for (auto leaf : layoutTree.GetChangedLeaves())
+            {
+                auto window{ layoutTree.GetWindow(leaf) };
+                if (window != nullptr)
+                {
+                    windowGeometry.SetTarget(window, layoutTree.GetRect(leaf));
+                }
+            }
 
-            InvalidateRect(hWnd, nullptr, true);
+            windowGeometry.Commit();
         }
         break;
     }
+    case WM_DISPLAYCHANGE:
+    {
+        // Monitors came, went or changed resolution; any precomputed layout is stale.
+        if (screenInfo.IsUsingLayoutMap())
+        {
+            screenInfo.UseLayoutMap(true);
+        }
+
+        SendMessage(hWnd, WM_SIZE, 0, 0);
+        break;
+    }
+    case WM_ERASEBKGND:
+    {
+        // The tiled renderer paints every pixel itself, so skip the erase to avoid flicker.
+        if (parallelRendering)
+        {
+            return 1;
+        }
+
+        return DefWindowProc(hWnd, message, wParam, lParam);
+    }
     case WM_PAINT:
     {
+        LatencyRecorder::Scope timing{ latencyRecorder, LatencyStage::Paint };
+
         PAINTSTRUCT ps;
         HDC hdc = BeginPaint(hWnd, &ps);
 
-        auto oldPen{ SelectObject(hdc, GetStockObject(DC_PEN)) };
-        auto oldFont{ SelectObject(hdc, font) };
-        auto oldBrush{ SelectObject(hdc, GetStockObject(DC_BRUSH)) };
+        auto bestIndex{ screenInfo.GetBestIndexForHorizontalContent() };
 
-        for (unsigned int i = 0; i < screenInfo.GetRectCount(); ++i)
+        if (parallelRendering)
+        {
+            PaintTiled(hWnd, hdc, ps.rcPaint, bestIndex);
+        }
+        else
         {
-            auto thisRect{ screenInfo.GetRect(i) };
+            auto oldPen{ SelectObject(hdc, GetStockObject(DC_PEN)) };
+            auto oldFont{ SelectObject(hdc, font) };
+            auto oldBrush{ SelectObject(hdc, GetStockObject(DC_BRUSH)) };
 
-            static wchar_t buffer[500];
-            swprintf_s(buffer, L"Rect %d, size: %d x %d\r\n(%d, %d) - (%d, %d)",
-                i, RectWidth(thisRect), RectHeight(thisRect),
-                thisRect.left, thisRect.top, thisRect.right, thisRect.bottom);
+            for (unsigned int i = 0; i < screenInfo.GetRectCount(); ++i)
+            {
+                auto box{ GetRegionBox(i, bestIndex) };
+                auto state{ ClipToUsableArea(hdc, i) };
 
-            auto shrunkRect{ thisRect };
-            InflateRect(&shrunkRect, -MARGIN, -MARGIN);
+                SetDCBrushColor(hdc, GetRegionFillColor(i));
+                SetDCPenColor(hdc, GetRegionOutlineColor(i));
+                Rectangle(hdc, box.left, box.top, box.right, box.bottom);
 
-            // Add space for the heading text if necessary (it's always drawn in the "best" rect)
-            if (i == screenInfo.GetBestIndexForHorizontalContent())
-            {
-                shrunkRect.top += TEXT_HEIGHT + MARGIN;
-            }
+                if (documentView)
+                {
+                    DrawDocumentRegion(hdc, i);
+                }
+                else
+                {
+                    DrawRegionLabel(hdc, i, box);
+                }
 
-            // Blue or yellow brushes?
-            SetDCBrushColor(hdc, (i % 2) ? RGB(255, 255, 0) : RGB(0, 255, 255));
-            SetDCPenColor(hdc, (i % 2) ? RGB(128, 128, 0) : RGB(0, 128, 128));;
-            Rectangle(hdc, shrunkRect.left, shrunkRect.top, shrunkRect.right, shrunkRect.bottom);
+                if (state != 0)
+                {
+                    RestoreDC(hdc, state);
+                }
+            }
 
-            // Shrink again for another margin
-            InflateRect(&shrunkRect, -MARGIN, -MARGIN);
-            DrawTextW(hdc, buffer, -1, &shrunkRect, DT_CENTER);
+            SelectObject(hdc, oldPen);
+            SelectObject(hdc, oldFont);
+            SelectObject(hdc, oldBrush);
         }
 
-        SelectObject(hdc, oldPen);
-        SelectObject(hdc, oldFont);
-        SelectObject(hdc, oldBrush);
-
         EndPaint(hWnd, &ps);
     }
     case WM_COMMAND:
@@ -217,6 +739,37 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             MessageBoxA(hWnd, (std::string("Build timestamp: ") + __TIMESTAMP__).c_str(), "About App", MB_OK);
             break;
 
+        case IDM_TOOLS_PARALLELRENDERING:
+            parallelRendering = !parallelRendering;
+            CheckMenuItem(GetMenu(hWnd), IDM_TOOLS_PARALLELRENDERING, parallelRendering ? MF_CHECKED : MF_UNCHECKED);
+            InvalidateRect(hWnd, nullptr, true);
+            break;
+
+        case IDM_TOOLS_DOCUMENTVIEW:
+            documentView = !documentView;
+            CheckMenuItem(GetMenu(hWnd), IDM_TOOLS_DOCUMENTVIEW, documentView ? MF_CHECKED : MF_UNCHECKED);
+            if (documentView)
+            {
+                ReflowDocument(screenInfo);
+            }
+            InvalidateRect(hWnd, nullptr, true);
+            break;
+
+        case IDM_TOOLS_LATENCYTEST:
+            RunLatencyHarness(hWnd);
+            break;
+
+        case IDM_TOOLS_DUMPHISTORY:
+            if (layoutHistory.Dump(L"layout-history.csv"))
+            {
+                MessageBoxA(hWnd, "Layout history written to layout-history.csv", "Layout history", MB_OK);
+            }
+            else
+            {
+                MessageBoxA(hWnd, "Couldn't write layout-history.csv", "Layout history", MB_OK | MB_ICONERROR);
+            }
+            break;
+
         case IDM_TOOLS_TOGGLEMODES:
         {
             bool currentlyEmulating{ screenInfo.IsEmulating() };
@@ -275,6 +828,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     }
     case WM_DESTROY:
     {
+        DeleteDC(measureDc);
         DeleteObject(font);
         PostQuitMessage(0);
         break;
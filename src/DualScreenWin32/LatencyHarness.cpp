@@ -0,0 +1,474 @@
+#include "stdafx.h"
+#include "LatencyHarness.h"
+#include "LayoutMap.h"
+#include "RegionMask.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+
+using namespace dual_screen;
+
+namespace
+{
+    // Per-pixel equivalent of RegionMask::RoundedRect, down to the rounding, so the
+    // bitmap and span versions of the mask workload agree exactly.
+    void FillRoundedRect(std::vector<unsigned char>& bitmap, int stride, const RECT& rect, int radius,
+        unsigned char value)
+    {
+        radius = std::max(0, std::min(radius, std::min(RectWidth(rect), RectHeight(rect)) / 2));
+
+        for (LONG y = rect.top; y < rect.bottom; ++y)
+        {
+            double dy{ 0 };
+            if (y < rect.top + radius)
+            {
+                dy = radius - (y - rect.top + 0.5);
+            }
+            else if (y >= rect.bottom - radius)
+            {
+                dy = (y - (rect.bottom - radius) + 0.5);
+            }
+
+            auto halfWidth{ std::sqrt(std::max(0.0, double(radius) * radius - dy * dy)) };
+            auto inset{ static_cast<LONG>(std::lround(radius - halfWidth)) };
+            for (auto x = rect.left + inset; x < rect.right - inset; ++x)
+            {
+                bitmap[static_cast<size_t>(y) * stride + x] = value;
+            }
+        }
+    }
+}
+
+const wchar_t* dual_screen::GetStageName(LatencyStage stage)
+{
+    switch (stage)
+    {
+    case LatencyStage::Update: return L"update";
+    case LatencyStage::Format: return L"format";
+    case LatencyStage::Layout: return L"layout";
+    case LatencyStage::Paint: return L"paint";
+    case LatencyStage::Total: return L"total";
+    default: return L"unknown";
+    }
+}
+
+std::string dual_screen::GetBuildId()
+{
+#ifdef LATENCY_BUILD_ID
+    return LATENCY_BUILD_ID;
+#else
+    // __TIMESTAMP__ would only change when this file does, not when (say) ScreenInfo.cpp
+    // is the thing being benchmarked.
+    auto image{ reinterpret_cast<const BYTE*>(GetModuleHandleW(nullptr)) };
+    auto dosHeader{ reinterpret_cast<const IMAGE_DOS_HEADER*>(image) };
+    auto ntHeaders{ reinterpret_cast<const IMAGE_NT_HEADERS*>(image + dosHeader->e_lfanew) };
+
+    char id[16];
+    sprintf_s(id, "%08lx", static_cast<unsigned long>(ntHeaders->FileHeader.TimeDateStamp));
+    return id;
+#endif
+}
+
+LatencyRecorder::Scope::Scope(LatencyRecorder& recorder, LatencyStage stage) :
+    m_recorder{ recorder },
+    m_stage{ stage },
+    m_start{ recorder.IsRunning() ? Clock::now() : Clock::time_point{} }
+{
+}
+
+LatencyRecorder::Scope::~Scope()
+{
+    if (m_recorder.IsRunning())
+    {
+        m_recorder.Record(m_stage, Clock::now() - m_start);
+    }
+}
+
+LatencyRecorder::LatencyRecorder(unsigned int expectedSamples) :
+    m_expectedSamples{ expectedSamples }
+{
+}
+
+// Throws away any previous results.
+void LatencyRecorder::Start()
+{
+    for (auto& samples : m_samples)
+    {
+        samples.clear();
+        samples.reserve(m_expectedSamples);
+    }
+
+    m_running = true;
+}
+
+void LatencyRecorder::Stop()
+{
+    m_running = false;
+}
+
+bool LatencyRecorder::IsRunning() const
+{
+    return m_running;
+}
+
+void LatencyRecorder::Record(LatencyStage stage, Clock::duration elapsed)
+{
+    m_samples[static_cast<int>(stage)].push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+}
+
+LatencyRecorder::Summary LatencyRecorder::Summarize(LatencyStage stage) const
+{
+    Summary summary{};
+
+    auto sorted{ m_samples[static_cast<int>(stage)] };
+    if (sorted.empty())
+    {
+        return summary;
+    }
+
+    std::sort(std::begin(sorted), std::end(sorted));
+
+    // Nearest-rank percentiles: the smallest sample with at least p of them at or below it.
+    auto percentile = [&sorted](double p)
+    {
+        auto rank{ static_cast<size_t>(std::ceil(p * sorted.size())) };
+        return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+    };
+
+    double totalMicroseconds{ 0 };
+    for (auto sample : sorted)
+    {
+        totalMicroseconds += sample;
+    }
+
+    summary.count = static_cast<unsigned int>(sorted.size());
+    summary.p50 = percentile(0.50);
+    summary.p99 = percentile(0.99);
+    summary.p999 = percentile(0.999);
+    summary.throughput = totalMicroseconds > 0 ? summary.count * 1000000.0 / totalMicroseconds : 0;
+
+    return summary;
+}
+
+bool LatencyRecorder::AppendCsv(const wchar_t* path, const wchar_t* scenario) const
+{
+    FILE* file{ nullptr };
+    if (_wfopen_s(&file, path, L"a") != 0 || file == nullptr)
+    {
+        return false;
+    }
+
+    // New file -- add the header first
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0)
+    {
+        fprintf(file, "build,scenario,stage,count,p50_us,p99_us,p999_us,events_per_sec\n");
+    }
+
+    auto build{ GetBuildId() };
+    for (int i = 0; i < static_cast<int>(LatencyStage::Count); ++i)
+    {
+        auto stage{ static_cast<LatencyStage>(i) };
+        auto summary{ Summarize(stage) };
+
+        // Some scenarios only time some stages (eg the mask scenarios are Total only).
+        if (summary.count == 0)
+        {
+            continue;
+        }
+
+        fprintf(file, "\"%s\",%ls,%ls,%u,%.2f,%.2f,%.2f,%.1f\n", build.c_str(), scenario, GetStageName(stage),
+            summary.count, summary.p50, summary.p99, summary.p999, summary.throughput);
+    }
+
+    fclose(file);
+    return true;
+}
+
+std::vector<SyntheticEvent> dual_screen::GenerateDrag(const RECT& window, const RECT& area, unsigned int steps)
+{
+    std::vector<SyntheticEvent> events;
+    events.reserve(2 * (steps + 1));
+
+    auto width{ RectWidth(window) };
+    auto travel{ std::max(0, RectWidth(area) - width) };
+
+    // There and back again, so every boundary is crossed in both directions.
+    for (unsigned int pass = 0; pass < 2; ++pass)
+    {
+        for (unsigned int i = 0; i <= steps; ++i)
+        {
+            auto step{ pass == 0 ? i : steps - i };
+            auto offset{ static_cast<long long>(travel) * step / std::max(1u, steps) };
+            auto left{ area.left + static_cast<int>(offset) };
+
+            SyntheticEvent e{};
+            e.windowRect = RECT{ left, window.top, left + width, window.bottom };
+            events.push_back(e);
+        }
+    }
+
+    return events;
+}
+
+std::vector<SyntheticEvent> dual_screen::GenerateResizeStorm(const RECT& window, unsigned int steps,
+    int amplitude)
+{
+    std::vector<SyntheticEvent> events;
+    events.reserve(steps);
+
+    // A cheap deterministic pseudo-random walk, so runs are repeatable across builds.
+    unsigned int seed{ 12345 };
+    for (unsigned int i = 0; i < steps; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        auto dx{ static_cast<int>((seed >> 8) % (2 * amplitude + 1)) - amplitude };
+        seed = seed * 1103515245 + 12345;
+        auto dy{ static_cast<int>((seed >> 8) % (2 * amplitude + 1)) - amplitude };
+
+        SyntheticEvent e{};
+        e.windowRect = RECT{ window.left, window.top, window.right + dx, window.bottom + dy };
+        events.push_back(e);
+    }
+
+    return events;
+}
+
+std::vector<SyntheticEvent> dual_screen::GenerateHotplugBurst(unsigned int bursts)
+{
+    // Plug in a second screen, rotate it, rotate back, unplug.
+    const struct { int screens; SplitKind splitKind; } sequence[]
+    {
+        { 2, SplitKind::Vertical },
+        { 2, SplitKind::Horizontal },
+        { 2, SplitKind::Vertical },
+        { 1, SplitKind::None },
+    };
+
+    std::vector<SyntheticEvent> events;
+    events.reserve(bursts * _countof(sequence));
+
+    for (unsigned int i = 0; i < bursts; ++i)
+    {
+        for (const auto& step : sequence)
+        {
+            SyntheticEvent e{};
+            e.kind = SyntheticEvent::Kind::Screens;
+            e.emulatedScreens = step.screens;
+            e.splitKind = step.splitKind;
+            events.push_back(e);
+        }
+    }
+
+    return events;
+}
+
+std::vector<SyntheticEvent> dual_screen::GenerateRepaints(unsigned int count)
+{
+    SyntheticEvent e{};
+    e.kind = SyntheticEvent::Kind::Repaint;
+
+    return std::vector<SyntheticEvent>(count, e);
+}
+
+std::vector<RECT> dual_screen::GenerateClientRects(const std::vector<RECT>& monitors, int minRectSize,
+    unsigned int count)
+{
+    std::vector<RECT> clients;
+    if (monitors.empty())
+    {
+        return clients;
+    }
+
+    RECT bounds{ monitors[0] };
+    std::vector<LONG> xEdges, yEdges;
+    for (const auto& monitor : monitors)
+    {
+        UnionRect(&bounds, &bounds, &monitor);
+        for (auto offset : { -minRectSize, 0, minRectSize })
+        {
+            xEdges.insert(std::end(xEdges), { monitor.left + offset, monitor.right + offset });
+            yEdges.insert(std::end(yEdges), { monitor.top + offset, monitor.bottom + offset });
+        }
+    }
+
+    // Same cheap deterministic generator as the resize storm.
+    unsigned int seed{ 12345 };
+    auto next = [&seed](unsigned int range)
+    {
+        seed = seed * 1103515245 + 12345;
+        return static_cast<LONG>((seed >> 8) % range);
+    };
+
+    auto pick = [&next, minRectSize](const std::vector<LONG>& edges, LONG low, LONG high)
+    {
+        if (next(2) == 0)
+        {
+            return edges[next(static_cast<unsigned int>(edges.size()))] + next(3) - 1;
+        }
+
+        auto slack{ minRectSize * 2 };
+        return low - slack + next(static_cast<unsigned int>(high - low + 2 * slack + 1));
+    };
+
+    clients.reserve(count);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        RECT client{ pick(xEdges, bounds.left, bounds.right), pick(yEdges, bounds.top, bounds.bottom),
+            pick(xEdges, bounds.left, bounds.right), pick(yEdges, bounds.top, bounds.bottom) };
+
+        if (client.right < client.left)
+        {
+            std::swap(client.left, client.right);
+        }
+
+        if (client.bottom < client.top)
+        {
+            std::swap(client.top, client.bottom);
+        }
+
+        // Windows always have a client area of at least a pixel.
+        client.right = std::max(client.right, client.left + 1);
+        client.bottom = std::max(client.bottom, client.top + 1);
+        clients.push_back(client);
+    }
+
+    return clients;
+}
+
+unsigned int dual_screen::CountLayoutMapMismatches(HWND hWnd, int minRectSize,
+    const std::vector<RECT>& clientRects)
+{
+    LayoutMap map{ ScreenInfo::GetMonitorRects(), minRectSize };
+    std::vector<RECT> actual;
+
+    // A separate ScreenInfo, so the app's own (which may be using a map) is left alone.
+    ScreenInfo reference{};
+    reference.SetMinRectSize(minRectSize);
+
+    // How far the frame sticks out around the client area, to turn client rects into
+    // window rects.
+    RECT window{};
+    ::GetWindowRect(hWnd, &window);
+    RECT client{};
+    ::GetClientRect(hWnd, &client);
+    POINT origin{ 0, 0 };
+    ClientToScreen(hWnd, &origin);
+    OffsetRect(&client, origin.x, origin.y);
+
+    unsigned int mismatches{ 0 };
+    for (const auto& target : clientRects)
+    {
+        SetWindowPos(hWnd, nullptr,
+            target.left - (client.left - window.left), target.top - (client.top - window.top),
+            RectWidth(target) + RectWidth(window) - RectWidth(client),
+            RectHeight(target) + RectHeight(window) - RectHeight(client),
+            SWP_NOZORDER | SWP_NOACTIVATE | SWP_NOREDRAW);
+
+        // The window won't always end up exactly where it was asked to (eg it has a
+        // minimum size), so look up wherever it actually is.
+        reference.Update(hWnd);
+
+        auto clientInScreen{ reference.GetClientRect() };
+        origin = POINT{ 0, 0 };
+        ClientToScreen(hWnd, &origin);
+        OffsetRect(&clientInScreen, origin.x, origin.y);
+        map.Lookup(clientInScreen, actual);
+
+        bool same{ actual.size() == reference.GetRectCount() };
+        for (unsigned int i = 0; same && i < actual.size(); ++i)
+        {
+            auto expected{ reference.GetRect(i) };
+            same = EqualRect(&expected, &actual[i]) != FALSE;
+        }
+
+        if (!same)
+        {
+            ++mismatches;
+        }
+    }
+
+    return mismatches;
+}
+
+MaskWorkload MaskWorkload::ForPanel(int width, int height)
+{
+    MaskWorkload workload{};
+    workload.width = width;
+    workload.height = height;
+    workload.cornerRadius = std::min(width, height) / 20;
+
+    // Centred at the top, a little way in from the edge.
+    auto diameter{ std::max(2, std::min(width, height) / 30) };
+    auto left{ (width - diameter) / 2 };
+    workload.cutout = RECT{ left, diameter, left + diameter, 2 * diameter };
+    return workload;
+}
+
+bool MaskWorkloadResult::IsSameAs(const MaskWorkloadResult& other) const
+{
+    return area == other.area && coveredTiles == other.coveredTiles;
+}
+
+MaskWorkloadResult dual_screen::RunMaskWorkloadSpans(const MaskWorkload& workload)
+{
+    RECT panel{ 0, 0, workload.width, workload.height };
+    auto usable{ RegionMask::RoundedRect(panel, workload.cornerRadius)
+        .Subtract(RegionMask::RoundedRect(workload.cutout, RectWidth(workload.cutout) / 2)) };
+
+    MaskWorkloadResult result{};
+    result.area = usable.GetArea();
+
+    for (int y = 0; y < workload.height; y += workload.tileSize)
+    {
+        for (int x = 0; x < workload.width; x += workload.tileSize)
+        {
+            RECT tile{ x, y, std::min(x + workload.tileSize, workload.width),
+                std::min(y + workload.tileSize, workload.height) };
+            if (usable.Contains(tile))
+            {
+                ++result.coveredTiles;
+            }
+        }
+    }
+
+    return result;
+}
+
+MaskWorkloadResult dual_screen::RunMaskWorkloadBitmap(const MaskWorkload& workload)
+{
+    std::vector<unsigned char> usable(static_cast<size_t>(workload.width) * workload.height, 0);
+    RECT panel{ 0, 0, workload.width, workload.height };
+    FillRoundedRect(usable, workload.width, panel, workload.cornerRadius, 1);
+    FillRoundedRect(usable, workload.width, workload.cutout, RectWidth(workload.cutout) / 2, 0);
+
+    MaskWorkloadResult result{};
+    for (auto pixel : usable)
+    {
+        result.area += pixel;
+    }
+
+    for (int y = 0; y < workload.height; y += workload.tileSize)
+    {
+        for (int x = 0; x < workload.width; x += workload.tileSize)
+        {
+            auto right{ std::min(x + workload.tileSize, workload.width) };
+            auto bottom{ std::min(y + workload.tileSize, workload.height) };
+
+            bool covered{ true };
+            for (auto row = y; row < bottom && covered; ++row)
+            {
+                auto pixels{ &usable[static_cast<size_t>(row) * workload.width] };
+                covered = std::find(pixels + x, pixels + right, 0) == pixels + right;
+            }
+
+            if (covered)
+            {
+                ++result.coveredTiles;
+            }
+        }
+    }
+
+    return result;
+}
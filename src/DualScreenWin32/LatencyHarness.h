@@ -0,0 +1,149 @@
+#pragma once
+#include <vector>
+#include <chrono>
+#include <string>
+#include "ScreenInfo.h"
+
+namespace dual_screen
+{
+    // The stages between a window-geometry change and the updated frame.
+    enum class LatencyStage
+    {
+        Update,     // ScreenInfo::Update
+        Format,     // Building and setting the status text
+        Layout,     // Notifying subscribers, layout tree and window moves
+        Paint,      // WM_PAINT
+        Total,      // From the geometry change until the frame has been painted
+        Count
+    };
+
+    const wchar_t* GetStageName(LatencyStage stage);
+
+    // Identifies the build of the running app: LATENCY_BUILD_ID if it was defined
+    // (eg by a CI build), otherwise the timestamp the linker put in the executable,
+    // which changes whenever any part of the app is rebuilt.
+    std::string GetBuildId();
+
+    // LatencyRecorder collects per-stage timings while it is running. Samples go
+    // into preallocated buffers so recording doesn't disturb what it measures.
+    class LatencyRecorder
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        struct Summary
+        {
+            unsigned int count{ 0 };
+            double p50{ 0 };            // microseconds
+            double p99{ 0 };
+            double p999{ 0 };
+            double throughput{ 0 };     // events per second, if this stage were the only work
+        };
+
+        // Times a stage for as long as the scope is alive; does nothing unless
+        // the recorder is running.
+        class Scope
+        {
+        public:
+            Scope(LatencyRecorder& recorder, LatencyStage stage);
+            ~Scope();
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            LatencyRecorder& m_recorder;
+            LatencyStage m_stage;
+            Clock::time_point m_start;
+        };
+
+        explicit LatencyRecorder(unsigned int expectedSamples = 4096);
+
+        void Start();
+        void Stop();
+        bool IsRunning() const;
+
+        void Record(LatencyStage stage, Clock::duration elapsed);
+        Summary Summarize(LatencyStage stage) const;
+
+        // Appends one line per stage that has samples, tagged with the scenario and
+        // build (see GetBuildId), to a CSV file so results from different builds can
+        // be compared side-by-side.
+        bool AppendCsv(const wchar_t* path, const wchar_t* scenario) const;
+
+    private:
+        bool m_running{ false };
+        unsigned int m_expectedSamples;
+        std::vector<double> m_samples[static_cast<int>(LatencyStage::Count)];
+    };
+
+    // One step of a synthetic event stream.
+    struct SyntheticEvent
+    {
+        enum class Kind
+        {
+            Geometry,   // Move and/or resize the window to 'windowRect'
+            Screens,    // Change the (emulated) screen configuration, like a hotplug or rotation
+            Repaint     // Nothing changes; just repaint the whole window
+        };
+
+        Kind kind{ Kind::Geometry };
+        RECT windowRect{ 0 };
+        int emulatedScreens{ 0 };
+        SplitKind splitKind{ SplitKind::None };
+    };
+
+    // Drags a window of the given size back and forth across 'area' (eg the whole
+    // virtual screen), so it crosses every monitor boundary along the way.
+    std::vector<SyntheticEvent> GenerateDrag(const RECT& window, const RECT& area, unsigned int steps);
+
+    // Rapidly grows and shrinks the window around its current size.
+    std::vector<SyntheticEvent> GenerateResizeStorm(const RECT& window, unsigned int steps, int amplitude);
+
+    // Bursts of screen configuration changes: screens coming and going and rotating
+    // between side-by-side and stacked.
+    std::vector<SyntheticEvent> GenerateHotplugBurst(unsigned int bursts);
+
+    // Full repaints with no layout change, for measuring frame time on its own.
+    std::vector<SyntheticEvent> GenerateRepaints(unsigned int count);
+
+    // Client areas (in screen coordinates) for checking a LayoutMap. Each edge is
+    // either anywhere around the monitors or snapped onto (or just either side of) a
+    // monitor edge or min-size offset, which is where the layout changes shape.
+    std::vector<RECT> GenerateClientRects(const std::vector<RECT>& monitors, int minRectSize,
+        unsigned int count);
+
+    // Differential check of LayoutMap::Lookup against what ScreenInfo gets from
+    // GetContentRects (without a map) on the real monitors: moves the window so its
+    // client area lands on each rect in turn, and compares the two. Returns the
+    // number that disagree. The window is left wherever the last rect put it.
+    unsigned int CountLayoutMapMismatches(HWND hWnd, int minRectSize, const std::vector<RECT>& clientRects);
+
+    // A panel's usable area: rounded corners, minus a round camera cutout, then
+    // checked against a grid of tiles the way a renderer would.
+    struct MaskWorkload
+    {
+        int width{ 0 };
+        int height{ 0 };
+        int cornerRadius{ 0 };
+        RECT cutout{ 0 };
+        int tileSize{ 64 };
+
+        // A typical phone-style panel of the given size.
+        static MaskWorkload ForPanel(int width, int height);
+    };
+
+    struct MaskWorkloadResult
+    {
+        long long area{ 0 };
+        unsigned int coveredTiles{ 0 };     // Tiles entirely inside the usable area
+
+        bool IsSameAs(const MaskWorkloadResult& other) const;
+    };
+
+    // The same workload done with RegionMask spans, and with a byte per pixel (the
+    // obvious alternative), so the two can be timed against each other on large
+    // panels. Both should always give the same result.
+    MaskWorkloadResult RunMaskWorkloadSpans(const MaskWorkload& workload);
+    MaskWorkloadResult RunMaskWorkloadBitmap(const MaskWorkload& workload);
+}
@@ -0,0 +1,222 @@
+#include "stdafx.h"
+#include "LayoutHistory.h"
+#include <algorithm>
+#include <cstdio>
+
+using namespace dual_screen;
+
+namespace
+{
+    const wchar_t* GetSplitKindName(SplitKind splitKind)
+    {
+        switch (splitKind)
+        {
+        case SplitKind::None: return L"none";
+        case SplitKind::Vertical: return L"vertical";
+        case SplitKind::Horizontal: return L"horizontal";
+        default: return L"unknown";
+        }
+    }
+}
+
+bool LayoutHistory::Diff::IsEmpty() const
+{
+    return !splitKindChanged && !clientResized && moved == 0 && resized == 0 && added == 0 && removed == 0;
+}
+
+LayoutHistory::LayoutHistory(unsigned int capacity, unsigned int maxRectsPerVersion) :
+    m_capacity{ std::max(1u, capacity) },
+    m_maxRects{ std::max(1u, maxRectsPerVersion) }
+{
+    m_versions.resize(m_capacity);
+    m_arena.resize(static_cast<size_t>(m_capacity) * m_maxRects);
+
+    for (unsigned int i = 0; i < m_capacity; ++i)
+    {
+        m_versions[i].rects = &m_arena[static_cast<size_t>(i) * m_maxRects];
+    }
+}
+
+void LayoutHistory::Record(const ScreenInfo& screenInfo)
+{
+    auto slot{ m_next };
+    m_next = (m_next + 1) % m_capacity;
+    if (m_count < m_capacity)
+    {
+        ++m_count;
+    }
+
+    auto& version{ m_versions[slot] };
+    version.generation = screenInfo.GetGeneration();
+    version.timestamp = Clock::now();
+    version.splitKind = screenInfo.GetSplitKind();
+    version.clientRect = screenInfo.GetClientRect();
+
+    version.rectCount = screenInfo.GetRectCount();
+    version.truncated = version.rectCount > m_maxRects;
+    if (version.truncated)
+    {
+        version.rectCount = m_maxRects;
+    }
+
+    auto rects{ &m_arena[static_cast<size_t>(slot) * m_maxRects] };
+    for (unsigned int i = 0; i < version.rectCount; ++i)
+    {
+        rects[i] = screenInfo.GetRect(i);
+    }
+}
+
+void LayoutHistory::Clear()
+{
+    m_next = 0;
+    m_count = 0;
+}
+
+unsigned int LayoutHistory::GetCapacity() const
+{
+    return m_capacity;
+}
+
+unsigned int LayoutHistory::GetCount() const
+{
+    return m_count;
+}
+
+const LayoutHistory::Version* LayoutHistory::GetVersion(unsigned int age) const
+{
+    if (age >= m_count)
+    {
+        return nullptr;
+    }
+
+    return &m_versions[GetSlot(age)];
+}
+
+const LayoutHistory::Version* LayoutHistory::FindGeneration(unsigned int generation) const
+{
+    // Ages run newest to oldest, so generations go down as the age goes up.
+    unsigned int low{ 0 };
+    unsigned int high{ m_count };
+    while (low < high)
+    {
+        auto mid{ low + (high - low) / 2 };
+        if (m_versions[GetSlot(mid)].generation > generation)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    if (low < m_count && m_versions[GetSlot(low)].generation == generation)
+    {
+        return &m_versions[GetSlot(low)];
+    }
+
+    return nullptr;
+}
+
+bool LayoutHistory::Compare(unsigned int fromAge, unsigned int toAge, Diff& diff) const
+{
+    auto from{ GetVersion(fromAge) };
+    auto to{ GetVersion(toAge) };
+    if (from == nullptr || to == nullptr)
+    {
+        return false;
+    }
+
+    diff = Compare(*from, *to);
+    return true;
+}
+
+LayoutHistory::Diff LayoutHistory::Compare(const Version& from, const Version& to)
+{
+    Diff diff{};
+    diff.fromGeneration = from.generation;
+    diff.toGeneration = to.generation;
+    diff.elapsed = to.timestamp - from.timestamp;
+    diff.splitKindChanged = from.splitKind != to.splitKind;
+    diff.clientResized = RectWidth(from.clientRect) != RectWidth(to.clientRect) ||
+        RectHeight(from.clientRect) != RectHeight(to.clientRect);
+
+    auto common{ std::min(from.rectCount, to.rectCount) };
+    auto total{ std::max(from.rectCount, to.rectCount) };
+
+    for (unsigned int i = 0; i < total; ++i)
+    {
+        bool changed{ true };
+        if (i >= common)
+        {
+            if (i < to.rectCount)
+            {
+                ++diff.added;
+            }
+            else
+            {
+                ++diff.removed;
+            }
+        }
+        else if (RectWidth(from.rects[i]) != RectWidth(to.rects[i]) || RectHeight(from.rects[i]) != RectHeight(to.rects[i]))
+        {
+            ++diff.resized;
+        }
+        else if (from.rects[i].left != to.rects[i].left || from.rects[i].top != to.rects[i].top)
+        {
+            ++diff.moved;
+        }
+        else
+        {
+            ++diff.unchanged;
+            changed = false;
+        }
+
+        if (changed && i < 32)
+        {
+            diff.changedMask |= 1u << i;
+        }
+    }
+
+    return diff;
+}
+
+bool LayoutHistory::Dump(const wchar_t* path) const
+{
+    FILE* file{ nullptr };
+    if (_wfopen_s(&file, path, L"w") != 0 || file == nullptr)
+    {
+        return false;
+    }
+
+    fprintf(file, "age,generation,ms_since_previous,split,client_w,client_h,rects,moved,resized,added,removed,regions\n");
+
+    for (auto age = m_count; age-- > 0;)
+    {
+        const auto& version{ *GetVersion(age) };
+
+        // The oldest version is compared with itself, so it shows no changes.
+        auto diff{ Compare(age + 1 < m_count ? *GetVersion(age + 1) : version, version) };
+
+        fprintf(file, "%u,%u,%.3f,%ls,%d,%d,%u%s,%u,%u,%u,%u,\"", age, version.generation,
+            std::chrono::duration<double, std::milli>(diff.elapsed).count(), GetSplitKindName(version.splitKind),
+            RectWidth(version.clientRect), RectHeight(version.clientRect), version.rectCount, version.truncated ? "+" : "",
+            diff.moved, diff.resized, diff.added, diff.removed);
+
+        for (unsigned int i = 0; i < version.rectCount; ++i)
+        {
+            const auto& rect{ version.rects[i] };
+            fprintf(file, "%s(%ld,%ld)-(%ld,%ld)", i > 0 ? " " : "", rect.left, rect.top, rect.right, rect.bottom);
+        }
+
+        fprintf(file, "\"\n");
+    }
+
+    fclose(file);
+    return true;
+}
+
+unsigned int LayoutHistory::GetSlot(unsigned int age) const
+{
+    return (m_next + m_capacity - 1 - age) % m_capacity;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <vector>
+#include <chrono>
+#include "ScreenInfo.h"
+
+namespace dual_screen
+{
+    // LayoutHistory keeps the last N layouts (and when they happened) so layout churn
+    // can be lined up against dropped frames after the fact.
+    //
+    // Everything is allocated up front: versions live in a fixed-size ring, and their
+    // rects live in one shared arena with a fixed slice per version. Recording a layout
+    // just overwrites the oldest slot, so it never allocates.
+    class LayoutHistory
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        struct Version
+        {
+            unsigned int generation{ 0 };
+            Clock::time_point timestamp{};
+            SplitKind splitKind{ SplitKind::Unknown };
+            RECT clientRect{};
+            unsigned int rectCount{ 0 };
+            bool truncated{ false };        // There were more rects than fit in a slice
+            const RECT* rects{ nullptr };   // Points into the arena; valid until the slot is reused
+        };
+
+        // How the regions changed from one version to another. Regions are matched up
+        // by index, since ScreenInfo always orders them the same way.
+        struct Diff
+        {
+            unsigned int fromGeneration{ 0 };
+            unsigned int toGeneration{ 0 };
+            Clock::duration elapsed{};
+
+            bool splitKindChanged{ false };
+            bool clientResized{ false };
+
+            unsigned int unchanged{ 0 };
+            unsigned int moved{ 0 };        // Same size, different position
+            unsigned int resized{ 0 };
+            unsigned int added{ 0 };
+            unsigned int removed{ 0 };
+
+            // Bit i is set if region i moved, resized, appeared or disappeared (first 32 only).
+            unsigned int changedMask{ 0 };
+
+            bool IsEmpty() const;
+        };
+
+        explicit LayoutHistory(unsigned int capacity = 256, unsigned int maxRectsPerVersion = 8);
+
+        // Versions point into the arena, so the history can't be copied.
+        LayoutHistory(const LayoutHistory&) = delete;
+        LayoutHistory& operator=(const LayoutHistory&) = delete;
+
+        // Records the current layout, replacing the oldest version once the ring is full.
+        void Record(const ScreenInfo& screenInfo);
+        void Clear();
+
+        unsigned int GetCapacity() const;
+        unsigned int GetCount() const;
+
+        // Version 'age' steps back from the newest (0); nullptr if it's no longer retained.
+        const Version* GetVersion(unsigned int age) const;
+
+        // Binary search by generation (they only ever go up); nullptr if not retained.
+        const Version* FindGeneration(unsigned int generation) const;
+
+        // False if either version is no longer retained.
+        bool Compare(unsigned int fromAge, unsigned int toAge, Diff& diff) const;
+        static Diff Compare(const Version& from, const Version& to);
+
+        // Writes every retained version, oldest first, each with its diff from the one
+        // before, as CSV. Meant for post-mortems, so it's only done on request.
+        bool Dump(const wchar_t* path) const;
+
+    private:
+        unsigned int GetSlot(unsigned int age) const;
+
+        unsigned int m_capacity;
+        unsigned int m_maxRects;
+        unsigned int m_next{ 0 };   // Slot the next version goes into
+        unsigned int m_count{ 0 };
+
+        std::vector<Version> m_versions;
+        std::vector<RECT> m_arena;  // m_maxRects rects per slot
+    };
+}
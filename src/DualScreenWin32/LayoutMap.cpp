@@ -0,0 +1,166 @@
+#include "stdafx.h"
+#include "LayoutMap.h"
+#include "ScreenInfo.h"
+#include <algorithm>
+
+using namespace dual_screen;
+
+LayoutMap::LayoutMap(const std::vector<RECT>& monitors, int minRectSize) :
+    m_monitors{ monitors },
+    m_minRectSize{ minRectSize }
+{
+    // Every comparison the layout code makes is between a client edge and a monitor
+    // edge, or a width/height and the min size - so these are the only places where
+    // the result can change shape.
+    for (const auto& monitor : m_monitors)
+    {
+        for (auto x : { monitor.left, monitor.right })
+        {
+            m_xBreakpoints.push_back(x);
+            m_xBreakpoints.push_back(x - minRectSize);
+            m_xBreakpoints.push_back(x + minRectSize);
+        }
+
+        for (auto y : { monitor.top, monitor.bottom })
+        {
+            m_yBreakpoints.push_back(y);
+            m_yBreakpoints.push_back(y - minRectSize);
+            m_yBreakpoints.push_back(y + minRectSize);
+        }
+    }
+
+    for (auto breakpoints : { &m_xBreakpoints, &m_yBreakpoints })
+    {
+        std::sort(std::begin(*breakpoints), std::end(*breakpoints));
+        auto last{ std::unique(std::begin(*breakpoints), std::end(*breakpoints)) };
+        breakpoints->erase(last, std::end(*breakpoints));
+    }
+}
+
+void LayoutMap::ComputeContentRects(const std::vector<RECT>& monitors, int minRectSize,
+    const RECT& clientInScreen, std::vector<RECT>& rects)
+{
+    rects.clear();
+    for (const auto& monitor : monitors)
+    {
+        RECT clipped{};
+        if (IntersectRect(&clipped, &monitor, &clientInScreen))
+        {
+            OffsetRect(&clipped, -clientInScreen.left, -clientInScreen.top);
+            rects.push_back(clipped);
+        }
+    }
+
+    NormalizeContentRects(rects, minRectSize);
+}
+
+void LayoutMap::Lookup(const RECT& clientInScreen, std::vector<RECT>& rects)
+{
+    Cell cell{};
+    cell.left = FindInterval(m_xBreakpoints, clientInScreen.left);
+    cell.top = FindInterval(m_yBreakpoints, clientInScreen.top);
+    cell.right = FindInterval(m_xBreakpoints, clientInScreen.right);
+    cell.bottom = FindInterval(m_yBreakpoints, clientInScreen.bottom);
+    cell.narrow = RectWidth(clientInScreen) < m_minRectSize;
+    cell.short_ = RectHeight(clientInScreen) < m_minRectSize;
+
+    auto found{ m_cells.find(cell) };
+    if (found == std::end(m_cells))
+    {
+        found = m_cells.emplace(cell, BuildTemplate(clientInScreen)).first;
+    }
+
+    // Fill in the template, and convert to client coordinates like GetContentRects does.
+    const auto& templates{ found->second };
+    rects.resize(templates.size());
+    for (unsigned int i = 0; i < templates.size(); ++i)
+    {
+        const auto& t{ templates[i] };
+        rects[i] = RECT{
+            Evaluate(t.left, clientInScreen) - clientInScreen.left,
+            Evaluate(t.top, clientInScreen) - clientInScreen.top,
+            Evaluate(t.right, clientInScreen) - clientInScreen.left,
+            Evaluate(t.bottom, clientInScreen) - clientInScreen.top };
+    }
+}
+
+const std::vector<RECT>& LayoutMap::GetMonitors() const
+{
+    return m_monitors;
+}
+
+int LayoutMap::GetMinRectSize() const
+{
+    return m_minRectSize;
+}
+
+unsigned int LayoutMap::GetCachedCellCount() const
+{
+    return static_cast<unsigned int>(m_cells.size());
+}
+
+// Even numbers are the gaps between breakpoints, odd numbers are exactly on one.
+int LayoutMap::FindInterval(const std::vector<LONG>& breakpoints, LONG value)
+{
+    auto found{ std::lower_bound(std::begin(breakpoints), std::end(breakpoints), value) };
+    auto index{ static_cast<int>(found - std::begin(breakpoints)) };
+    bool exact{ found != std::end(breakpoints) && *found == value };
+
+    return index * 2 + (exact ? 1 : 0);
+}
+
+// Within a cell, a client edge is either strictly between two breakpoints (so it
+// can't be equal to any monitor edge) or pinned to one; either way, matching on
+// the value tells us where the coordinate came from.
+LayoutMap::Coordinate LayoutMap::Symbolize(LONG value, const RECT& client, bool horizontal)
+{
+    Coordinate coordinate{};
+    coordinate.value = value;
+
+    if (value == (horizontal ? client.left : client.top))
+    {
+        coordinate.source = horizontal ? Coordinate::Source::Left : Coordinate::Source::Top;
+    }
+    else if (value == (horizontal ? client.right : client.bottom))
+    {
+        coordinate.source = horizontal ? Coordinate::Source::Right : Coordinate::Source::Bottom;
+    }
+
+    return coordinate;
+}
+
+LONG LayoutMap::Evaluate(const Coordinate& coordinate, const RECT& client)
+{
+    switch (coordinate.source)
+    {
+    case Coordinate::Source::Left: return client.left;
+    case Coordinate::Source::Top: return client.top;
+    case Coordinate::Source::Right: return client.right;
+    case Coordinate::Source::Bottom: return client.bottom;
+    default: return coordinate.value;
+    }
+}
+
+// Does the full computation once for a representative client rect in the cell.
+std::vector<LayoutMap::RectTemplate> LayoutMap::BuildTemplate(const RECT& clientInScreen) const
+{
+    std::vector<RECT> rects;
+    ComputeContentRects(m_monitors, m_minRectSize, clientInScreen, rects);
+
+    std::vector<RectTemplate> templates;
+    templates.reserve(rects.size());
+    for (auto rect : rects)
+    {
+        // Back to screen coordinates, where the monitor edges are constants.
+        OffsetRect(&rect, clientInScreen.left, clientInScreen.top);
+
+        RectTemplate t{};
+        t.left = Symbolize(rect.left, clientInScreen, true);
+        t.top = Symbolize(rect.top, clientInScreen, false);
+        t.right = Symbolize(rect.right, clientInScreen, true);
+        t.bottom = Symbolize(rect.bottom, clientInScreen, false);
+        templates.push_back(t);
+    }
+
+    return templates;
+}
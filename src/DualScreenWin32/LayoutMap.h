@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <tuple>
+
+namespace dual_screen
+{
+    // For a fixed set of monitors, the content rects are a piecewise function of where
+    // the client area is: the only places the answer changes shape are where a client
+    // edge crosses a monitor edge, or comes within the min-rect size of one.
+    //
+    // LayoutMap records those breakpoints for each axis once per monitor topology. A
+    // lookup is then a binary search per edge to find which cell the client area is
+    // in, plus filling in that cell's rect template with the actual edges. Templates
+    // are worked out (using the same sort + collapse rules as ScreenInfo) the first
+    // time a cell is visited.
+    class LayoutMap
+    {
+    public:
+        // 'monitors' are in screen coordinates (see ScreenInfo::GetMonitorRects).
+        LayoutMap(const std::vector<RECT>& monitors, int minRectSize);
+
+        // The slow way, without any map: clips the client area to each monitor and
+        // then sorts and collapses the rects like ScreenInfo does with GetContentRects.
+        // Lookup must always give the same answer.
+        static void ComputeContentRects(const std::vector<RECT>& monitors, int minRectSize,
+            const RECT& clientInScreen, std::vector<RECT>& rects);
+
+        // Computes the content rects, in client coordinates, for a client area whose
+        // position on screen is 'clientInScreen'.
+        void Lookup(const RECT& clientInScreen, std::vector<RECT>& rects);
+
+        const std::vector<RECT>& GetMonitors() const;
+        int GetMinRectSize() const;
+
+        // Number of cells that have been visited (and so have a cached template).
+        unsigned int GetCachedCellCount() const;
+
+    private:
+        // Where one coordinate of a result rect comes from.
+        struct Coordinate
+        {
+            enum class Source
+            {
+                Constant,   // A monitor edge
+                Left,       // One of the client area's edges
+                Top,
+                Right,
+                Bottom
+            };
+
+            Source source{ Source::Constant };
+            LONG value{ 0 };
+        };
+
+        struct RectTemplate
+        {
+            Coordinate left, top, right, bottom;
+        };
+
+        // Which interval of the breakpoints each client edge is in, plus whether the
+        // client area itself is smaller than the min-rect size.
+        struct Cell
+        {
+            int left, top, right, bottom;
+            bool narrow, short_;
+
+            bool operator<(const Cell& other) const
+            {
+                return std::tie(left, top, right, bottom, narrow, short_) <
+                    std::tie(other.left, other.top, other.right, other.bottom, other.narrow, other.short_);
+            }
+        };
+
+        static int FindInterval(const std::vector<LONG>& breakpoints, LONG value);
+        static Coordinate Symbolize(LONG value, const RECT& client, bool horizontal);
+        static LONG Evaluate(const Coordinate& coordinate, const RECT& client);
+
+        std::vector<RectTemplate> BuildTemplate(const RECT& clientInScreen) const;
+
+        std::vector<RECT> m_monitors;
+        int m_minRectSize;
+
+        std::vector<LONG> m_xBreakpoints;
+        std::vector<LONG> m_yBreakpoints;
+
+        std::map<Cell, std::vector<RectTemplate>> m_cells;
+    };
+}
@@ -0,0 +1,120 @@
+#include "stdafx.h"
+#include "LayoutSubscriptions.h"
+
+using namespace dual_screen;
+
+// Same assumption as ScreenInfo: 2 regions cover most cases, and we only
+// re-allocate if the region count grows beyond what we've seen before.
+LayoutSubscriptions::LayoutSubscriptions()
+{
+    m_subscribers.reserve(4);
+    m_lastRects.reserve(2);
+}
+
+LayoutSubscriptions::SubscriptionId LayoutSubscriptions::Subscribe(LayoutChangeFilter filter,
+    Callback callback, void* context, unsigned int regionIndex)
+{
+    Subscriber subscriber{};
+    subscriber.filter = filter;
+    subscriber.callback = callback;
+    subscriber.context = context;
+    subscriber.regionIndex = regionIndex;
+
+    for (unsigned int i = 0; i < m_subscribers.size(); ++i)
+    {
+        if (m_subscribers[i].callback == nullptr)
+        {
+            m_subscribers[i] = subscriber;
+            return i;
+        }
+    }
+
+    m_subscribers.push_back(subscriber);
+    return static_cast<SubscriptionId>(m_subscribers.size() - 1);
+}
+
+void LayoutSubscriptions::Unsubscribe(SubscriptionId id)
+{
+    if (id >= 0 && static_cast<unsigned int>(id) < m_subscribers.size())
+    {
+        m_subscribers[id] = Subscriber{};
+    }
+}
+
+unsigned int LayoutSubscriptions::Publish(const ScreenInfo& screenInfo)
+{
+    // Coalesce: nothing material has happened since the last time we notified. The
+    // generation starts at 0 and only moves once Update has seen a non-empty layout,
+    // so this also holds everything back until there is something to lay out.
+    if (screenInfo.GetGeneration() == m_lastGeneration)
+    {
+        return 0;
+    }
+
+    bool splitKindChanged{ !m_hasPublished || screenInfo.GetSplitKind() != m_lastSplitKind };
+    unsigned int delivered{ 0 };
+
+    // Subscribers may (un)subscribe from inside a callback; anything added now
+    // will hear about the next generation.
+    auto count{ m_subscribers.size() };
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        auto subscriber{ m_subscribers[i] };
+        if (subscriber.callback == nullptr)
+        {
+            continue;
+        }
+
+        bool interested{ true };
+        if (subscriber.filter == LayoutChangeFilter::SplitKind)
+        {
+            interested = splitKindChanged;
+        }
+        else if (subscriber.filter == LayoutChangeFilter::Region)
+        {
+            interested = HasRegionChanged(screenInfo, subscriber.regionIndex);
+        }
+
+        if (interested)
+        {
+            subscriber.callback(subscriber.context, screenInfo);
+            ++delivered;
+        }
+    }
+
+    m_hasPublished = true;
+    m_lastGeneration = screenInfo.GetGeneration();
+    m_lastSplitKind = screenInfo.GetSplitKind();
+
+    m_lastRects.resize(screenInfo.GetRectCount());
+    for (unsigned int i = 0; i < screenInfo.GetRectCount(); ++i)
+    {
+        m_lastRects[i] = screenInfo.GetRect(i);
+    }
+
+    return delivered;
+}
+
+bool LayoutSubscriptions::HasRegionChanged(const ScreenInfo& screenInfo, unsigned int regionIndex) const
+{
+    if (!m_hasPublished)
+    {
+        return true;
+    }
+
+    bool existed{ regionIndex < m_lastRects.size() };
+    bool exists{ regionIndex < screenInfo.GetRectCount() };
+
+    if (existed != exists)
+    {
+        return true;
+    }
+
+    if (!exists)
+    {
+        return false;
+    }
+
+    auto rect{ screenInfo.GetRect(regionIndex) };
+    return !EqualRect(&rect, &m_lastRects[regionIndex]);
+}
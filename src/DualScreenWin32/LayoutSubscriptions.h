@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include "ScreenInfo.h"
+
+namespace dual_screen
+{
+    // What a subscriber wants to hear about.
+    enum class LayoutChangeFilter
+    {
+        Any,            // Any material change (same as ScreenInfo::Update returning true)
+        SplitKind,      // The split kind changed
+        Region          // A specific region appeared, disappeared, moved or resized
+    };
+
+    // LayoutSubscriptions lets components register for layout changes instead of
+    // each of them hooking WM_SIZE / WM_MOVE and polling ScreenInfo::Update.
+    //
+    // The owner calls Publish after updating the ScreenInfo; subscribers are only
+    // notified once per layout generation, no matter how many times Publish is
+    // called, and not at all until Update has reported a first material change.
+    // Callbacks are plain function pointers plus a context pointer so that nothing
+    // is allocated while notifying (a coroutine can subscribe by passing its
+    // handle's address as the context and resuming it from the callback).
+    class LayoutSubscriptions
+    {
+    public:
+        using SubscriptionId = int;
+        using Callback = void (*)(void* context, const ScreenInfo& screenInfo);
+
+        LayoutSubscriptions();
+
+        // 'regionIndex' is only used with LayoutChangeFilter::Region.
+        SubscriptionId Subscribe(LayoutChangeFilter filter, Callback callback, void* context,
+            unsigned int regionIndex = 0);
+        void Unsubscribe(SubscriptionId id);
+
+        // Notifies the interested subscribers if the layout generation has moved on
+        // since the last call. Returns the number of callbacks that were invoked.
+        unsigned int Publish(const ScreenInfo& screenInfo);
+
+    private:
+        struct Subscriber
+        {
+            LayoutChangeFilter filter{ LayoutChangeFilter::Any };
+            Callback callback{ nullptr };
+            void* context{ nullptr };
+            unsigned int regionIndex{ 0 };
+        };
+
+        bool HasRegionChanged(const ScreenInfo& screenInfo, unsigned int regionIndex) const;
+
+        // Unsubscribed slots have a null callback and get reused.
+        std::vector<Subscriber> m_subscribers;
+
+        bool m_hasPublished{ false };
+        unsigned int m_lastGeneration{ 0 };
+        SplitKind m_lastSplitKind{ SplitKind::Unknown };
+        std::vector<RECT> m_lastRects;
+    };
+}
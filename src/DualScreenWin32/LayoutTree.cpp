@@ -0,0 +1,371 @@
+#include "stdafx.h"
+#include "LayoutTree.h"
+#include <algorithm>
+
+using namespace dual_screen;
+
+LayoutTree::LayoutTree()
+{
+    SetRegionRect(0, RECT{ 0 });
+}
+
+LayoutTree::NodeId LayoutTree::GetRegionRoot(unsigned int regionIndex) const
+{
+    return regionIndex < m_roots.size() ? m_roots[regionIndex] : InvalidNode;
+}
+
+unsigned int LayoutTree::GetRegionCount() const
+{
+    return static_cast<unsigned int>(m_roots.size());
+}
+
+void LayoutTree::SetRegions(const ScreenInfo& screenInfo, int inset)
+{
+    for (unsigned int i = 0; i < screenInfo.GetRectCount(); ++i)
+    {
+        auto rect{ screenInfo.GetRect(i) };
+        InflateRect(&rect, -inset, -inset);
+        SetRegionRect(i, rect);
+    }
+
+    // Regions that went away (eg the window moved back onto one screen) keep their
+    // panes, but they collapse to nothing until the region comes back.
+    for (unsigned int i = screenInfo.GetRectCount(); i < GetRegionCount(); ++i)
+    {
+        SetRegionRect(i, RECT{ 0 });
+    }
+}
+
+void LayoutTree::SetRegionRect(unsigned int regionIndex, const RECT& rect)
+{
+    while (m_roots.size() <= regionIndex)
+    {
+        m_roots.push_back(AddNode(InvalidNode, NodeKind::Stack, SplitKind::None, {}, nullptr));
+    }
+
+    auto root{ m_roots[regionIndex] };
+    auto& node{ m_nodes[root] };
+
+    if (!EqualRect(&node.rect, &rect))
+    {
+        node.rect = rect;
+        MarkDirty(root);
+    }
+}
+
+LayoutTree::NodeId LayoutTree::AddSplit(NodeId parent, SplitKind splitKind, LayoutSize size)
+{
+    return AddNode(parent, NodeKind::Split, splitKind, size, nullptr);
+}
+
+LayoutTree::NodeId LayoutTree::AddStack(NodeId parent, LayoutSize size)
+{
+    return AddNode(parent, NodeKind::Stack, SplitKind::None, size, nullptr);
+}
+
+LayoutTree::NodeId LayoutTree::AddLeaf(NodeId parent, LayoutSize size, HWND window)
+{
+    return AddNode(parent, NodeKind::Leaf, SplitKind::None, size, window);
+}
+
+void LayoutTree::RemoveNode(NodeId node)
+{
+    if (!IsValidNode(node) || m_nodes[node].parent == InvalidNode)
+    {
+        return;
+    }
+
+    Detach(node);
+    FreeSubtree(node);
+}
+
+bool LayoutTree::MoveNode(NodeId node, NodeId newParent)
+{
+    if (!IsValidNode(node) || !IsValidNode(newParent) ||
+        m_nodes[node].parent == InvalidNode || m_nodes[newParent].kind == NodeKind::Leaf)
+    {
+        return false;
+    }
+
+    for (auto ancestor = newParent; ancestor != InvalidNode; ancestor = m_nodes[ancestor].parent)
+    {
+        if (ancestor == node)
+        {
+            return false;
+        }
+    }
+
+    if (m_nodes[node].parent == newParent)
+    {
+        return true;
+    }
+
+    Detach(node);
+    m_nodes[node].parent = newParent;
+    m_nodes[newParent].children.push_back(node);
+    MarkDirty(newParent);
+
+    return true;
+}
+
+void LayoutTree::SetSize(NodeId node, LayoutSize size)
+{
+    auto& thisNode{ m_nodes[node] };
+    if (thisNode.size.kind == size.kind && thisNode.size.value == size.value)
+    {
+        return;
+    }
+
+    thisNode.size = size;
+
+    // Our size only matters to the parent, which has to re-divide its space.
+    if (thisNode.parent != InvalidNode)
+    {
+        MarkDirty(thisNode.parent);
+    }
+}
+
+void LayoutTree::SetSplitKind(NodeId node, SplitKind splitKind)
+{
+    auto& thisNode{ m_nodes[node] };
+    if (thisNode.kind == NodeKind::Split && thisNode.splitKind != splitKind)
+    {
+        thisNode.splitKind = splitKind;
+        MarkDirty(node);
+    }
+}
+
+LayoutTree::NodeKind LayoutTree::GetKind(NodeId node) const
+{
+    return m_nodes[node].kind;
+}
+
+RECT LayoutTree::GetRect(NodeId node) const
+{
+    return m_nodes[node].rect;
+}
+
+HWND LayoutTree::GetWindow(NodeId node) const
+{
+    return m_nodes[node].window;
+}
+
+LayoutTree::NodeId LayoutTree::GetParent(NodeId node) const
+{
+    return m_nodes[node].parent;
+}
+
+bool LayoutTree::Update()
+{
+    m_visitCount = 0;
+    m_changedLeaves.clear();
+
+    for (auto root : m_roots)
+    {
+        if (m_nodes[root].dirty || m_nodes[root].subtreeDirty)
+        {
+            UpdateNode(root);
+        }
+    }
+
+    return !m_changedLeaves.empty();
+}
+
+const std::vector<LayoutTree::NodeId>& LayoutTree::GetChangedLeaves() const
+{
+    return m_changedLeaves;
+}
+
+unsigned int LayoutTree::GetLastVisitCount() const
+{
+    return m_visitCount;
+}
+
+bool LayoutTree::IsValidNode(NodeId node) const
+{
+    return node >= 0 && static_cast<size_t>(node) < m_nodes.size();
+}
+
+LayoutTree::NodeId LayoutTree::AddNode(NodeId parent, NodeKind kind, SplitKind splitKind, LayoutSize size, HWND window)
+{
+    Node node{};
+    node.kind = kind;
+    node.splitKind = splitKind;
+    node.size = size;
+    node.window = window;
+    node.parent = parent;
+
+    NodeId id{ InvalidNode };
+    if (!m_freeNodes.empty())
+    {
+        id = m_freeNodes.back();
+        m_freeNodes.pop_back();
+        m_nodes[id] = node;
+    }
+    else
+    {
+        id = static_cast<NodeId>(m_nodes.size());
+        m_nodes.push_back(node);
+    }
+
+    if (parent != InvalidNode)
+    {
+        m_nodes[parent].children.push_back(id);
+        MarkDirty(parent);
+    }
+
+    return id;
+}
+
+// Unhooks the node from its parent, which then has to re-divide its space.
+void LayoutTree::Detach(NodeId node)
+{
+    auto parent{ m_nodes[node].parent };
+    auto& siblings{ m_nodes[parent].children };
+    siblings.erase(std::remove(std::begin(siblings), std::end(siblings), node), std::end(siblings));
+    m_nodes[node].parent = InvalidNode;
+
+    MarkDirty(parent);
+}
+
+void LayoutTree::FreeSubtree(NodeId node)
+{
+    for (auto child : m_nodes[node].children)
+    {
+        FreeSubtree(child);
+    }
+
+    m_nodes[node] = Node{};
+    m_freeNodes.push_back(node);
+}
+
+// Flags the node and then tells every ancestor that there is something to do
+// below it. We can stop as soon as we hit an ancestor that already knows.
+void LayoutTree::MarkDirty(NodeId node)
+{
+    m_nodes[node].dirty = true;
+
+    auto parent{ m_nodes[node].parent };
+    while (parent != InvalidNode && !m_nodes[parent].subtreeDirty)
+    {
+        m_nodes[parent].subtreeDirty = true;
+        parent = m_nodes[parent].parent;
+    }
+}
+
+void LayoutTree::UpdateNode(NodeId node)
+{
+    ++m_visitCount;
+
+    auto& thisNode{ m_nodes[node] };
+    if (thisNode.dirty)
+    {
+        if (thisNode.kind == NodeKind::Leaf)
+        {
+            m_changedLeaves.push_back(node);
+        }
+        else
+        {
+            LayoutChildren(thisNode);
+        }
+    }
+
+    thisNode.dirty = false;
+    thisNode.subtreeDirty = false;
+
+    for (auto child : thisNode.children)
+    {
+        if (m_nodes[child].dirty || m_nodes[child].subtreeDirty)
+        {
+            UpdateNode(child);
+        }
+    }
+}
+
+// Fixed children get exactly what they ask for (as long as there's room), and
+// the rest is shared between the flex children by weight. The last flex child
+// absorbs any rounding error so there are never any gaps.
+void LayoutTree::LayoutChildren(Node& node)
+{
+    if (node.kind == NodeKind::Stack)
+    {
+        for (auto child : node.children)
+        {
+            SetChildRect(child, node.rect);
+        }
+
+        return;
+    }
+
+    bool sideBySide{ node.splitKind == SplitKind::Vertical };
+    int extent{ sideBySide ? RectWidth(node.rect) : RectHeight(node.rect) };
+
+    int fixedTotal{ 0 }, flexTotal{ 0 };
+    NodeId lastFlex{ InvalidNode };
+    for (auto child : node.children)
+    {
+        const auto& size{ m_nodes[child].size };
+        if (size.kind == LayoutSize::Kind::Fixed)
+        {
+            fixedTotal += size.value;
+        }
+        else
+        {
+            flexTotal += size.value;
+            lastFlex = child;
+        }
+    }
+
+    int flexSpace{ std::max(0, extent - fixedTotal) };
+    int flexRemaining{ flexSpace };
+    LONG position{ sideBySide ? node.rect.left : node.rect.top };
+    LONG end{ sideBySide ? node.rect.right : node.rect.bottom };
+
+    for (auto child : node.children)
+    {
+        const auto& size{ m_nodes[child].size };
+        LONG length{ 0 };
+
+        if (size.kind == LayoutSize::Kind::Fixed)
+        {
+            length = size.value;
+        }
+        else if (child == lastFlex)
+        {
+            length = flexRemaining;
+        }
+        else if (flexTotal > 0)
+        {
+            length = flexSpace * size.value / flexTotal;
+            flexRemaining -= length;
+        }
+
+        length = std::max<LONG>(0, std::min(length, end - position));
+
+        auto childRect{ node.rect };
+        if (sideBySide)
+        {
+            childRect.left = position;
+            childRect.right = position + length;
+        }
+        else
+        {
+            childRect.top = position;
+            childRect.bottom = position + length;
+        }
+
+        SetChildRect(child, childRect);
+        position += length;
+    }
+}
+
+void LayoutTree::SetChildRect(NodeId child, const RECT& rect)
+{
+    auto& childNode{ m_nodes[child] };
+    if (!EqualRect(&childNode.rect, &rect))
+    {
+        // Only the child itself needs work; the parent is already being visited.
+        childNode.rect = rect;
+        childNode.dirty = true;
+    }
+}
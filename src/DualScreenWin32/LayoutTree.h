@@ -0,0 +1,123 @@
+#pragma once
+#include <vector>
+#include "ScreenInfo.h"
+
+namespace dual_screen
+{
+    // How much space a node wants along its parent's split axis.
+    struct LayoutSize
+    {
+        enum class Kind
+        {
+            Fixed,
+            Flex
+        };
+
+        static LayoutSize Fixed(int pixels) { return { Kind::Fixed, pixels }; }
+        static LayoutSize Flex(int weight = 1) { return { Kind::Flex, weight }; }
+
+        Kind kind{ Kind::Flex };
+
+        // Pixels for Fixed, relative weight for Flex.
+        int value{ 1 };
+    };
+
+    // LayoutTree arranges child panes (splits, stacks and leaf windows) inside
+    // the content regions reported by ScreenInfo. There is one root per region.
+    //
+    // Changes only mark the affected nodes dirty; Update then walks down just the
+    // dirty paths, so resizing one pane doesn't relayout every other region. The
+    // tree has no dependency on any HWND state, so it can be driven headlessly.
+    class LayoutTree
+    {
+    public:
+        using NodeId = int;
+        static constexpr NodeId InvalidNode{ -1 };
+
+        enum class NodeKind
+        {
+            Split,  // Children are laid out next to each other
+            Stack,  // Children all get the full rect of the parent
+            Leaf    // No children; optionally owns a window
+        };
+
+        // Starts with a single (empty) region, since a window always has at least one,
+        // so panes can be added before the first layout.
+        LayoutTree();
+
+        // Returns the root for the given region, or InvalidNode if there's no such region.
+        NodeId GetRegionRoot(unsigned int regionIndex) const;
+        unsigned int GetRegionCount() const;
+
+        // Sets root i to content region i, shrunk by 'inset' on every side; any roots
+        // beyond the ScreenInfo's rect count are emptied.
+        void SetRegions(const ScreenInfo& screenInfo, int inset = 0);
+
+        // Adds roots up to 'regionIndex' if there aren't that many yet.
+        void SetRegionRect(unsigned int regionIndex, const RECT& rect);
+
+        // 'splitKind' follows ScreenInfo: Vertical means side-by-side, Horizontal means stacked.
+        NodeId AddSplit(NodeId parent, SplitKind splitKind, LayoutSize size = {});
+        NodeId AddStack(NodeId parent, LayoutSize size = {});
+        NodeId AddLeaf(NodeId parent, LayoutSize size = {}, HWND window = nullptr);
+
+        // Removes a pane and everything under it. Region roots (and InvalidNode) are
+        // ignored, and the ids of removed nodes may be handed out again by later Add calls.
+        void RemoveNode(NodeId node);
+
+        // Moves a pane (with everything under it) to the end of another parent's
+        // children, eg to follow the "best" region. Fails for roots, for InvalidNode,
+        // or if 'newParent' is inside the pane itself.
+        bool MoveNode(NodeId node, NodeId newParent);
+
+        void SetSize(NodeId node, LayoutSize size);
+        void SetSplitKind(NodeId node, SplitKind splitKind);
+
+        NodeKind GetKind(NodeId node) const;
+        RECT GetRect(NodeId node) const;
+        HWND GetWindow(NodeId node) const;
+        NodeId GetParent(NodeId node) const;
+
+        // Recomputes the dirty subtrees. Returns true if any leaf moved.
+        bool Update();
+
+        // Leaves whose rect changed during the last Update.
+        const std::vector<NodeId>& GetChangedLeaves() const;
+
+        // Number of nodes visited by the last Update; useful to check that a
+        // change only touched the subtrees it needed to.
+        unsigned int GetLastVisitCount() const;
+
+    private:
+        struct Node
+        {
+            NodeKind kind{ NodeKind::Leaf };
+            SplitKind splitKind{ SplitKind::None };
+            LayoutSize size{};
+            RECT rect{ 0 };
+            HWND window{ nullptr };
+            NodeId parent{ InvalidNode };
+            std::vector<NodeId> children;
+
+            // 'dirty' means this node's children need to be laid out again (or, for
+            // a leaf, that its rect changed). 'subtreeDirty' means some descendant is dirty.
+            bool dirty{ false };
+            bool subtreeDirty{ false };
+        };
+
+        bool IsValidNode(NodeId node) const;
+        NodeId AddNode(NodeId parent, NodeKind kind, SplitKind splitKind, LayoutSize size, HWND window);
+        void Detach(NodeId node);
+        void FreeSubtree(NodeId node);
+        void MarkDirty(NodeId node);
+        void UpdateNode(NodeId node);
+        void LayoutChildren(Node& node);
+        void SetChildRect(NodeId child, const RECT& rect);
+
+        std::vector<Node> m_nodes;
+        std::vector<NodeId> m_roots;
+        std::vector<NodeId> m_freeNodes;
+        std::vector<NodeId> m_changedLeaves;
+        unsigned int m_visitCount{ 0 };
+    };
+}
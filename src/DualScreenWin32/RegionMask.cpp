@@ -0,0 +1,348 @@
+#include "stdafx.h"
+#include "RegionMask.h"
+#include "ScreenInfo.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace dual_screen;
+
+namespace
+{
+    bool IsSameSpan(const RegionMask::Span& a, const RegionMask::Span& b)
+    {
+        return a.left == b.left && a.right == b.right;
+    }
+
+    // For upper_bound: the first span that starts after x.
+    bool StartsAfter(LONG x, const RegionMask::Span& span)
+    {
+        return x < span.left;
+    }
+
+    // Appends a span, merging it with the previous one if they touch.
+    void AppendSpan(std::vector<RegionMask::Span>& spans, LONG left, LONG right)
+    {
+        if (left >= right)
+        {
+            return;
+        }
+
+        if (!spans.empty() && spans.back().right >= left)
+        {
+            spans.back().right = std::max(spans.back().right, right);
+        }
+        else
+        {
+            spans.push_back({ left, right });
+        }
+    }
+
+    void IntersectRow(const RegionMask::Span* a, unsigned int aCount,
+        const RegionMask::Span* b, unsigned int bCount, std::vector<RegionMask::Span>& result)
+    {
+        unsigned int i{ 0 }, j{ 0 };
+        while (i < aCount && j < bCount)
+        {
+            AppendSpan(result, std::max(a[i].left, b[j].left), std::min(a[i].right, b[j].right));
+
+            // Advance whichever span finishes first.
+            if (a[i].right < b[j].right)
+            {
+                ++i;
+            }
+            else
+            {
+                ++j;
+            }
+        }
+    }
+
+    void SubtractRow(const RegionMask::Span* a, unsigned int aCount,
+        const RegionMask::Span* b, unsigned int bCount, std::vector<RegionMask::Span>& result)
+    {
+        unsigned int j{ 0 };
+        for (unsigned int i = 0; i < aCount; ++i)
+        {
+            auto left{ a[i].left };
+
+            // Skip holes that end before this span starts.
+            while (j < bCount && b[j].right <= left)
+            {
+                ++j;
+            }
+
+            // Cut out every hole that overlaps this span; the last one may also
+            // overlap the next span, so don't move past it.
+            auto k{ j };
+            while (k < bCount && b[k].left < a[i].right)
+            {
+                AppendSpan(result, left, b[k].left);
+                left = std::max(left, b[k].right);
+                ++k;
+            }
+
+            AppendSpan(result, left, a[i].right);
+        }
+    }
+}
+
+RegionMask::RegionMask(const RECT& rect)
+{
+    m_top = rect.top;
+
+    Span span{ rect.left, rect.right };
+    for (LONG y = rect.top; y < rect.bottom; ++y)
+    {
+        AddRow(&span, rect.left < rect.right ? 1 : 0);
+    }
+
+    Finish();
+}
+
+RegionMask RegionMask::RoundedRect(const RECT& rect, int radius)
+{
+    RegionMask mask{};
+    mask.m_top = rect.top;
+
+    radius = std::max(0, std::min(radius, std::min(RectWidth(rect), RectHeight(rect)) / 2));
+
+    for (LONG y = rect.top; y < rect.bottom; ++y)
+    {
+        // Distance (from the centre of this row) into the corner's square, if any.
+        double dy{ 0 };
+        if (y < rect.top + radius)
+        {
+            dy = radius - (y - rect.top + 0.5);
+        }
+        else if (y >= rect.bottom - radius)
+        {
+            dy = (y - (rect.bottom - radius) + 0.5);
+        }
+
+        auto halfWidth{ std::sqrt(std::max(0.0, double(radius) * radius - dy * dy)) };
+        auto inset{ static_cast<LONG>(std::lround(radius - halfWidth)) };
+        Span span{ rect.left + inset, rect.right - inset };
+        mask.AddRow(&span, span.left < span.right ? 1 : 0);
+    }
+
+    mask.Finish();
+    return mask;
+}
+
+bool RegionMask::IsEmpty() const
+{
+    return m_area == 0;
+}
+
+// Masks are always kept in the same canonical form (no empty rows at either end,
+// no touching spans), so identical coverage means identical tables.
+bool RegionMask::IsSameAs(const RegionMask& other) const
+{
+    return m_top == other.m_top && m_rowStarts == other.m_rowStarts && m_spans.size() == other.m_spans.size() &&
+        std::equal(std::begin(m_spans), std::end(m_spans), std::begin(other.m_spans), IsSameSpan);
+}
+
+RECT RegionMask::GetBounds() const
+{
+    return m_bounds;
+}
+
+long long RegionMask::GetArea() const
+{
+    return m_area;
+}
+
+bool RegionMask::Contains(POINT point) const
+{
+    unsigned int count{ 0 };
+    auto spans{ GetRow(point.y, count) };
+
+    // Find the last span starting at or before x.
+    auto found{ std::upper_bound(spans, spans + count, point.x, StartsAfter) };
+    return found != spans && point.x < (found - 1)->right;
+}
+
+bool RegionMask::Contains(const RECT& rect) const
+{
+    if (rect.left >= rect.right || rect.top >= rect.bottom)
+    {
+        return true;
+    }
+
+    // Spans never touch, so a covered row must have a single span spanning the whole rect.
+    for (LONG y = rect.top; y < rect.bottom; ++y)
+    {
+        unsigned int count{ 0 };
+        auto spans{ GetRow(y, count) };
+
+        auto found{ std::upper_bound(spans, spans + count, rect.left, StartsAfter) };
+        if (found == spans || (found - 1)->right < rect.right)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+RegionMask RegionMask::Intersect(const RegionMask& other) const
+{
+    RegionMask result{};
+    if (IsEmpty() || other.IsEmpty())
+    {
+        return result;
+    }
+
+    auto top{ std::max(m_bounds.top, other.m_bounds.top) };
+    auto bottom{ std::min(m_bounds.bottom, other.m_bounds.bottom) };
+    result.m_top = top;
+
+    std::vector<Span> row;
+    for (LONG y = top; y < bottom; ++y)
+    {
+        unsigned int aCount{ 0 }, bCount{ 0 };
+        auto a{ GetRow(y, aCount) };
+        auto b{ other.GetRow(y, bCount) };
+
+        row.clear();
+        IntersectRow(a, aCount, b, bCount, row);
+        result.AddRow(row.data(), static_cast<unsigned int>(row.size()));
+    }
+
+    result.Finish();
+    return result;
+}
+
+RegionMask RegionMask::Subtract(const RegionMask& other) const
+{
+    RegionMask result{};
+    if (IsEmpty())
+    {
+        return result;
+    }
+
+    result.m_top = m_bounds.top;
+
+    std::vector<Span> row;
+    for (LONG y = m_bounds.top; y < m_bounds.bottom; ++y)
+    {
+        unsigned int aCount{ 0 }, bCount{ 0 };
+        auto a{ GetRow(y, aCount) };
+        auto b{ other.GetRow(y, bCount) };
+
+        row.clear();
+        SubtractRow(a, aCount, b, bCount, row);
+        result.AddRow(row.data(), static_cast<unsigned int>(row.size()));
+    }
+
+    result.Finish();
+    return result;
+}
+
+void RegionMask::Offset(int dx, int dy)
+{
+    m_top += dy;
+    for (auto& span : m_spans)
+    {
+        span.left += dx;
+        span.right += dx;
+    }
+
+    if (!IsEmpty())
+    {
+        OffsetRect(&m_bounds, dx, dy);
+    }
+}
+
+const RegionMask::Span* RegionMask::GetRow(LONG y, unsigned int& count) const
+{
+    auto rowCount{ static_cast<LONG>(m_rowStarts.size()) - 1 };
+    auto row{ y - m_top };
+
+    if (row < 0 || row >= rowCount)
+    {
+        count = 0;
+        return nullptr;
+    }
+
+    count = m_rowStarts[row + 1] - m_rowStarts[row];
+    return m_spans.data() + m_rowStarts[row];
+}
+
+std::vector<RECT> RegionMask::ToRects() const
+{
+    std::vector<RECT> rects;
+    auto rowCount{ static_cast<unsigned int>(m_rowStarts.size()) - 1 };
+
+    unsigned int bandStart{ 0 };
+    while (bandStart < rowCount)
+    {
+        auto first{ m_spans.data() + m_rowStarts[bandStart] };
+        auto count{ m_rowStarts[bandStart + 1] - m_rowStarts[bandStart] };
+
+        // Extend the band for as long as the rows are identical.
+        auto bandEnd{ bandStart + 1 };
+        while (bandEnd < rowCount &&
+            m_rowStarts[bandEnd + 1] - m_rowStarts[bandEnd] == count &&
+            std::equal(first, first + count, m_spans.data() + m_rowStarts[bandEnd], IsSameSpan))
+        {
+            ++bandEnd;
+        }
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            rects.push_back(RECT{ first[i].left, m_top + static_cast<LONG>(bandStart),
+                first[i].right, m_top + static_cast<LONG>(bandEnd) });
+        }
+
+        bandStart = bandEnd;
+    }
+
+    return rects;
+}
+
+void RegionMask::AddRow(const Span* spans, unsigned int count)
+{
+    m_spans.insert(std::end(m_spans), spans, spans + count);
+    m_rowStarts.push_back(static_cast<unsigned int>(m_spans.size()));
+}
+
+// Drops empty rows from the top and bottom, and works out the bounds and area.
+void RegionMask::Finish()
+{
+    auto rowCount{ static_cast<unsigned int>(m_rowStarts.size()) - 1 };
+
+    unsigned int first{ 0 };
+    while (first < rowCount && m_rowStarts[first + 1] == m_rowStarts[first])
+    {
+        ++first;
+    }
+
+    auto last{ rowCount };
+    while (last > first && m_rowStarts[last] == m_rowStarts[last - 1])
+    {
+        --last;
+    }
+
+    // Empty rows don't have any spans, so only the row table needs trimming.
+    m_rowStarts.erase(std::begin(m_rowStarts) + last + 1, std::end(m_rowStarts));
+    m_rowStarts.erase(std::begin(m_rowStarts), std::begin(m_rowStarts) + first);
+    m_top += first;
+
+    m_area = 0;
+    m_bounds = RECT{ 0 };
+    if (m_spans.empty())
+    {
+        m_top = 0;
+        return;
+    }
+
+    m_bounds = RECT{ m_spans.front().left, m_top, m_spans.front().right,
+        m_top + static_cast<LONG>(last - first) };
+    for (const auto& span : m_spans)
+    {
+        m_bounds.left = std::min(m_bounds.left, span.left);
+        m_bounds.right = std::max(m_bounds.right, span.right);
+        m_area += span.right - span.left;
+    }
+}
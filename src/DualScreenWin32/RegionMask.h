@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+
+namespace dual_screen
+{
+    // RegionMask describes which pixels of a content region are actually usable, for
+    // displays with rounded corners, camera cutouts or partially covered panels.
+    //
+    // Coverage is stored as run-length spans per scanline: each row is a sorted list
+    // of non-overlapping, non-adjacent [left, right) spans. Memory and the cost of
+    // every operation scale with the number of spans, not the number of pixels.
+    class RegionMask
+    {
+    public:
+        struct Span
+        {
+            LONG left;
+            LONG right;
+        };
+
+        // An empty mask.
+        RegionMask() = default;
+
+        // A mask covering the whole rect.
+        explicit RegionMask(const RECT& rect);
+
+        // A rect with its corners rounded off to the given radius.
+        static RegionMask RoundedRect(const RECT& rect, int radius);
+
+        bool IsEmpty() const;
+
+        // True if both cover exactly the same pixels.
+        bool IsSameAs(const RegionMask& other) const;
+        RECT GetBounds() const;
+        long long GetArea() const;
+
+        bool Contains(POINT point) const;
+
+        // True if every pixel of 'rect' is covered.
+        bool Contains(const RECT& rect) const;
+
+        RegionMask Intersect(const RegionMask& other) const;
+        RegionMask Subtract(const RegionMask& other) const;
+
+        void Offset(int dx, int dy);
+
+        // The spans of row 'y' (absolute coordinates); 'count' is 0 outside the mask.
+        const Span* GetRow(LONG y, unsigned int& count) const;
+
+        // For callers that only understand rectangles: the covered area as a list of
+        // non-overlapping rects, merging identical consecutive rows into bands.
+        std::vector<RECT> ToRects() const;
+
+    private:
+        void AddRow(const Span* spans, unsigned int count);
+        void Finish();
+
+        // Rows go from m_top to m_top + row count; row i's spans are
+        // m_spans[m_rowStarts[i] .. m_rowStarts[i + 1]).
+        LONG m_top{ 0 };
+        std::vector<unsigned int> m_rowStarts{ 0 };
+        std::vector<Span> m_spans;
+
+        RECT m_bounds{ 0 };
+        long long m_area{ 0 };
+    };
+}
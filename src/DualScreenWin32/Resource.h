@@ -11,6 +11,10 @@
 #define IDR_MAINFRAME                   128
 #define IDM_HELP_ABOUT                   32772
 #define IDM_TOOLS_TOGGLEMODES            32773
+#define IDM_TOOLS_LATENCYTEST            32774
+#define IDM_TOOLS_PARALLELRENDERING      32775
+#define IDM_TOOLS_DOCUMENTVIEW           32776
+#define IDM_TOOLS_DUMPHISTORY            32777
 #define IDC_STATIC                      -1
 
 // Next default values for new objects
@@ -19,7 +23,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NO_MFC                     1
 #define _APS_NEXT_RESOURCE_VALUE        129
-#define _APS_NEXT_COMMAND_VALUE         32774
+#define _APS_NEXT_COMMAND_VALUE         32778
 #define _APS_NEXT_CONTROL_VALUE         1000
 #define _APS_NEXT_SYMED_VALUE           110
 #endif
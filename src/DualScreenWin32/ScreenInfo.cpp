@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include "ScreenInfo.h"
 #include "contentrects.h"
+#include "LayoutMap.h"
 #include <algorithm>
 
 using namespace dual_screen;
@@ -109,6 +110,20 @@ void CollapseSmallRects(std::vector<RECT>& rects, int minRectSize)
     rects.erase(end, std::end(rects));
 }
 
+void dual_screen::NormalizeContentRects(std::vector<RECT>& rects, int minRectSize)
+{
+    // Make sure they're always in logical order and ignore any small slivers
+    if (rects.size() > 1)
+    {
+        std::sort(std::begin(rects), std::end(rects), [](const auto& r1, const auto& r2) { return r1 < r2; });
+
+        if (minRectSize > 0)
+        {
+            CollapseSmallRects(rects, minRectSize);
+        }
+    }
+}
+
 // ScreenInfo is a helper class that provides an abstraction over
 // the content rects API.
 // The helper defaults to a maximum of 2 content rects. We will dynamically 
@@ -118,6 +133,11 @@ ScreenInfo::ScreenInfo()
     m_contentRects.reserve(2);
 }
 
+// Out of line, where LayoutMap is a complete type.
+ScreenInfo::~ScreenInfo() = default;
+ScreenInfo::ScreenInfo(ScreenInfo&&) noexcept = default;
+ScreenInfo& ScreenInfo::operator=(ScreenInfo&&) noexcept = default;
+
 // Call whenever the size or position of the app changes.
 bool ScreenInfo::Update(HWND hWnd) noexcept // if we OOM on a RECT alloc, we're in bad shape...
 {
@@ -126,47 +146,34 @@ bool ScreenInfo::Update(HWND hWnd) noexcept // if we OOM on a RECT alloc, we're
     ::GetClientRect(hWnd, &m_clientRect);
     ::GetWindowRect(hWnd, &m_windowRect);
 
+    auto previousOrigin{ m_clientOrigin };
+    m_clientOrigin = POINT{ 0, 0 };
+    ClientToScreen(hWnd, &m_clientOrigin);
+    bool originMoved{ previousOrigin.x != m_clientOrigin.x || previousOrigin.y != m_clientOrigin.y };
+
     if (m_emulatedScreenCount > 0)
     {
-        return ComputeEmulatedScreens(snapshot);
+        return FinishUpdate(ComputeEmulatedScreens(snapshot), originMoved);
     }
 
-    std::vector<RECT> updatedRects{ 2 };
-    auto newRectCount{ static_cast<unsigned>(updatedRects.size()) };
+    std::vector<RECT> updatedRects;
 
-    while (GetContentRects(hWnd, &newRectCount, updatedRects.data()) == FALSE)
+    if (m_layoutMap != nullptr)
     {
-        // Only expected error is "you need a bigger array" - otherwise
-        // we will revert to GetClientRect.
-        if (GetLastError() != ERROR_MORE_DATA)
-        {
-            newRectCount = 1;
-            updatedRects = std::vector<RECT>{ m_clientRect };
-            break;
-        }
-
-        // Re-allocate, and try again.
-        updatedRects.resize(newRectCount);
+        // Binary search of the precomputed breakpoints rather than asking every monitor.
+        auto clientInScreen{ m_clientRect };
+        OffsetRect(&clientInScreen, m_clientOrigin.x, m_clientOrigin.y);
+        m_layoutMap->Lookup(clientInScreen, updatedRects);
     }
-
-    // Delete any no-longer-needed rects.
-    if (newRectCount < updatedRects.size())
+    else
     {
-        updatedRects.resize(newRectCount);
+        EnumerateContentRects(hWnd, updatedRects);
     }
 
-    // Make sure they're always in logical order and ignore any small slivers
-    if (newRectCount > 1)
-    {
-        std::sort(std::begin(updatedRects), std::end(updatedRects), [](const auto& r1, const auto& r2) { return r1 < r2; });
-        
-        if (GetMinRectSize() > 0)
-        {
-            CollapseSmallRects(updatedRects, GetMinRectSize());
-        }
-    }
+    auto newRectCount{ static_cast<unsigned>(updatedRects.size()) };
 
     m_contentRects = updatedRects;
+    ComputeMetrics();
 
     m_splitKind = SplitKind::Unknown;
 
@@ -190,7 +197,112 @@ bool ScreenInfo::Update(HWND hWnd) noexcept // if we OOM on a RECT alloc, we're
     }
 
     // No redraw needed if zero rects (minimized) or nothing has materially changed.
-    return newRectCount > 0 && !snapshot.IsSameAs(m_contentRects, m_clientRect);
+    auto changed{ newRectCount > 0 && !snapshot.IsSameAs(m_contentRects, m_clientRect) };
+    return FinishUpdate(changed, originMoved);
+}
+
+// Panel masks are fixed to the screen, so the region masks can change even when
+// the rects (which are relative to the client area) don't, eg when the window
+// moves around within one monitor.
+bool ScreenInfo::FinishUpdate(bool changed, bool originMoved)
+{
+    if ((changed || originMoved) && UpdateRegionMasks() && GetRectCount() > 0)
+    {
+        changed = true;
+    }
+
+    if (changed)
+    {
+        ++m_generation;
+    }
+
+    return changed;
+}
+
+// Works out each region's mask from the panels it's on. Returns true if any of
+// them changed.
+bool ScreenInfo::UpdateRegionMasks()
+{
+    std::vector<std::shared_ptr<const RegionMask>> masks;
+    if (!m_panelMasks.empty())
+    {
+        masks.resize(GetRectCount());
+    }
+
+    for (unsigned int i = 0; i < masks.size(); ++i)
+    {
+        auto region{ m_contentRects[i] };
+        OffsetRect(&region, m_clientOrigin.x, m_clientOrigin.y);
+
+        // A region can span more than one panel (eg once a sliver has been merged into
+        // its neighbour), so take away the unusable part of each panel it's on. Any
+        // part that isn't on a masked panel stays usable.
+        RegionMask mask{ region };
+        for (const auto& panelMask : m_panelMasks)
+        {
+            RECT overlap{};
+            if (IntersectRect(&overlap, &panelMask.panel, &region))
+            {
+                mask = mask.Subtract(RegionMask{ overlap }.Subtract(panelMask.usable));
+            }
+        }
+
+        if (mask.GetArea() < RectArea(region))
+        {
+            mask.Offset(-m_clientOrigin.x, -m_clientOrigin.y);
+            masks[i] = std::make_shared<const RegionMask>(std::move(mask));
+        }
+    }
+
+    bool changed{ false };
+    for (unsigned int i = 0; i < std::max(masks.size(), m_regionMasks.size()); ++i)
+    {
+        auto before{ i < m_regionMasks.size() ? m_regionMasks[i].get() : nullptr };
+        auto after{ i < masks.size() ? masks[i].get() : nullptr };
+        if ((before == nullptr) != (after == nullptr) || (before != nullptr && !before->IsSameAs(*after)))
+        {
+            changed = true;
+            break;
+        }
+    }
+
+    m_regionMasks = std::move(masks);
+    return changed;
+}
+
+// Asks GetContentRects for the current regions, then puts them into logical order.
+void ScreenInfo::EnumerateContentRects(HWND hWnd, std::vector<RECT>& rects) const
+{
+    rects.resize(2);
+    auto newRectCount{ static_cast<unsigned>(rects.size()) };
+
+    while (GetContentRects(hWnd, &newRectCount, rects.data()) == FALSE)
+    {
+        // Only expected error is "you need a bigger array" - otherwise
+        // we will revert to GetClientRect.
+        if (GetLastError() != ERROR_MORE_DATA)
+        {
+            newRectCount = 1;
+            rects = std::vector<RECT>{ m_clientRect };
+            break;
+        }
+
+        // Re-allocate, and try again.
+        rects.resize(newRectCount);
+    }
+
+    // Delete any no-longer-needed rects.
+    if (newRectCount < rects.size())
+    {
+        rects.resize(newRectCount);
+    }
+
+    NormalizeContentRects(rects, GetMinRectSize());
+}
+
+unsigned int ScreenInfo::GetGeneration() const
+{
+    return m_generation;
 }
 
 unsigned int ScreenInfo::GetRectCount() const
@@ -211,6 +323,27 @@ bool ScreenInfo::AreMultipleScreensPresent()
     return count > 1;
 }
 
+// Without a window, GetContentRects reports each monitor in screen coordinates.
+std::vector<RECT> ScreenInfo::GetMonitorRects()
+{
+    std::vector<RECT> monitors(2);
+    auto count{ static_cast<unsigned>(monitors.size()) };
+
+    while (GetContentRects(NULL, &count, monitors.data()) == FALSE)
+    {
+        if (GetLastError() != ERROR_MORE_DATA)
+        {
+            count = 0;
+            break;
+        }
+
+        monitors.resize(count);
+    }
+
+    monitors.resize(count);
+    return monitors;
+}
+
 SplitKind ScreenInfo::GetSplitKind() const
 {
     return m_splitKind;
@@ -231,40 +364,153 @@ RECT ScreenInfo::GetWindowRect() const
 // screen that has the most pixels
 int ScreenInfo::GetWidestIndex() const
 {
-    int width{ 0 };
-    int best{ -1 };
-    for (unsigned int i = 0; i < GetRectCount(); ++i)
-    {
-        auto thisWidth{ RectWidth(m_contentRects[i]) };
-        if (thisWidth > width)
-        {
-            width = thisWidth;
-            best = i;
-        }
-    }
-
-    return best;
+    return m_metrics.widest;
 }
 
 // If the window is split horizontally, we can choose to put content on the
 // screen that has the most pixels
 int ScreenInfo::GetTallestIndex() const
 {
-    int height{ 0 };
+    return m_metrics.tallest;
+}
+
+int ScreenInfo::GetLargestIndex() const
+{
+    return m_metrics.largest;
+}
+
+RECT ScreenInfo::GetBoundingRect() const
+{
+    return m_metrics.bounds;
+}
+
+long long ScreenInfo::GetTotalArea() const
+{
+    return m_metrics.totalArea;
+}
+
+const std::vector<unsigned int>& ScreenInfo::GetIndicesByArea() const
+{
+    return m_metrics.byArea;
+}
+
+void ScreenInfo::SetPanelMask(const RECT& panel, const RegionMask& usable)
+{
+    auto existing{ std::find_if(std::begin(m_panelMasks), std::end(m_panelMasks), [&panel](const PanelMask& p)
+        {
+            return EqualRect(&p.panel, &panel) != FALSE;
+        }) };
+
+    if (existing != std::end(m_panelMasks))
+    {
+        existing->usable = usable;
+    }
+    else
+    {
+        m_panelMasks.push_back({ panel, usable });
+    }
+
+    // Subscribers hear about it on the next Publish, like any other layout change.
+    if (UpdateRegionMasks())
+    {
+        ++m_generation;
+    }
+}
+
+void ScreenInfo::ClearPanelMasks()
+{
+    m_panelMasks.clear();
+    if (UpdateRegionMasks())
+    {
+        ++m_generation;
+    }
+}
+
+bool ScreenInfo::HasRegionMask(unsigned int index) const
+{
+    return index < m_regionMasks.size() && m_regionMasks[index] != nullptr;
+}
+
+RegionMask ScreenInfo::GetRegionMask(unsigned int index) const
+{
+    if (HasRegionMask(index))
+    {
+        return *m_regionMasks[index];
+    }
+
+    return RegionMask{ m_contentRects[index] };
+}
+
+std::vector<RECT> ScreenInfo::GetRegionRects(unsigned int index) const
+{
+    if (HasRegionMask(index))
+    {
+        return m_regionMasks[index]->ToRects();
+    }
+
+    return { m_contentRects[index] };
+}
+
+// Squared distance from 'point' to the nearest edge of 'rect' (0 if inside).
+static long long DistanceSquared(const RECT& rect, POINT point)
+{
+    long long dx{ point.x < rect.left ? rect.left - point.x : (point.x >= rect.right ? point.x - rect.right + 1 : 0) };
+    long long dy{ point.y < rect.top ? rect.top - point.y : (point.y >= rect.bottom ? point.y - rect.bottom + 1 : 0) };
+    return dx * dx + dy * dy;
+}
+
+int ScreenInfo::GetNearestIndex(POINT point) const
+{
+    // Regions never overlap, so at most one of them contains the point; otherwise the
+    // closest one wins. There's one region per monitor (at most), so a straight scan
+    // is a few comparisons; any per-point structure built in ComputeMetrics would cost
+    // more to keep up to date on every layout change than it could save here.
     int best{ -1 };
+    long long bestDistance{ 0 };
     for (unsigned int i = 0; i < GetRectCount(); ++i)
     {
-        auto thisHeight{ RectHeight(m_contentRects[i]) };
-        if (thisHeight > height)
+        auto distance{ DistanceSquared(m_contentRects[i], point) };
+        if (distance == 0)
+        {
+            return i;
+        }
+
+        if (best < 0 || distance < bestDistance)
         {
-            height = thisHeight;
             best = i;
+            bestDistance = distance;
         }
     }
 
     return best;
 }
 
+const std::vector<unsigned int>& ScreenInfo::GetIndicesInDirection(unsigned int index, RegionDirection direction) const
+{
+    static const std::vector<unsigned int> none;
+
+    auto entry{ static_cast<size_t>(index) * 4 + static_cast<int>(direction) };
+    if (index >= GetRectCount() || entry >= m_metrics.inDirection.size())
+    {
+        return none;
+    }
+
+    return m_metrics.inDirection[entry];
+}
+
+// How far 'r' is from 'from' in the given direction, or -1 if it isn't (entirely) on that side.
+static long DirectionalGap(const RECT& from, const RECT& r, RegionDirection direction)
+{
+    switch (direction)
+    {
+    case RegionDirection::Left: return r.right <= from.left ? from.left - r.right : -1;
+    case RegionDirection::Right: return r.left >= from.right ? r.left - from.right : -1;
+    case RegionDirection::Up: return r.bottom <= from.top ? from.top - r.bottom : -1;
+    case RegionDirection::Down: return r.top >= from.bottom ? r.top - from.bottom : -1;
+    default: return -1;
+    }
+}
+
 int ScreenInfo::GetBestIndexForHorizontalContent() const
 {
     if (m_splitKind == SplitKind::Vertical)
@@ -320,6 +566,12 @@ const bool ScreenInfo::IsEmulating() const
 void ScreenInfo::SetMinRectSize(int minSize)
 {
     m_minSizeForRect = minSize;
+
+    // The breakpoints depend on the min size.
+    if (m_layoutMap != nullptr)
+    {
+        UseLayoutMap(true);
+    }
 }
 
 int ScreenInfo::GetMinRectSize() const
@@ -327,6 +579,16 @@ int ScreenInfo::GetMinRectSize() const
     return m_minSizeForRect;
 }
 
+void ScreenInfo::UseLayoutMap(bool enable)
+{
+    m_layoutMap = enable ? std::make_unique<LayoutMap>(GetMonitorRects(), GetMinRectSize()) : nullptr;
+}
+
+bool ScreenInfo::IsUsingLayoutMap() const
+{
+    return m_layoutMap != nullptr;
+}
+
 bool ScreenInfo::ComputeEmulatedScreens(const ScreenInfo::Snapshot& snapshot)
 {
     int xDelta{ 0 }, yDelta{ 0 }, width{ 0 }, height{ 0 };
@@ -363,9 +625,90 @@ bool ScreenInfo::ComputeEmulatedScreens(const ScreenInfo::Snapshot& snapshot)
         }
     }
 
+    ComputeMetrics();
+
     return !snapshot.IsSameAs(GetSnapshot());
 }
 
+void ScreenInfo::ComputeMetrics()
+{
+    Metrics metrics{};
+    metrics.byArea = std::move(m_metrics.byArea);
+    metrics.byArea.clear();
+    metrics.inDirection = std::move(m_metrics.inDirection);
+
+    int width{ 0 }, height{ 0 };
+    long long area{ 0 };
+    for (unsigned int i = 0; i < GetRectCount(); ++i)
+    {
+        const auto& thisRect{ m_contentRects[i] };
+
+        if (RectWidth(thisRect) > width)
+        {
+            width = RectWidth(thisRect);
+            metrics.widest = i;
+        }
+
+        if (RectHeight(thisRect) > height)
+        {
+            height = RectHeight(thisRect);
+            metrics.tallest = i;
+        }
+
+        if (RectArea(thisRect) > area)
+        {
+            area = RectArea(thisRect);
+            metrics.largest = i;
+        }
+
+        if (i == 0)
+        {
+            metrics.bounds = thisRect;
+        }
+        else
+        {
+            UnionRect(&metrics.bounds, &metrics.bounds, &thisRect);
+        }
+
+        metrics.totalArea += RectArea(thisRect);
+        metrics.byArea.push_back(i);
+    }
+
+    // Ties keep their logical (top-left first) order.
+    std::stable_sort(std::begin(metrics.byArea), std::end(metrics.byArea), [this](unsigned int a, unsigned int b)
+        {
+            return RectArea(m_contentRects[a]) > RectArea(m_contentRects[b]);
+        });
+
+    // Neighbours in each direction, closest first (ties in logical order).
+    const RegionDirection directions[]{ RegionDirection::Left, RegionDirection::Up, RegionDirection::Right, RegionDirection::Down };
+    metrics.inDirection.resize(static_cast<size_t>(GetRectCount()) * 4);
+    for (unsigned int i = 0; i < GetRectCount(); ++i)
+    {
+        const auto& from{ m_contentRects[i] };
+        for (auto direction : directions)
+        {
+            auto& result{ metrics.inDirection[static_cast<size_t>(i) * 4 + static_cast<int>(direction)] };
+            result.clear();
+
+            for (unsigned int j = 0; j < GetRectCount(); ++j)
+            {
+                if (j != i && DirectionalGap(from, m_contentRects[j], direction) >= 0)
+                {
+                    result.push_back(j);
+                }
+            }
+
+            std::stable_sort(std::begin(result), std::end(result), [this, &from, direction](unsigned int a, unsigned int b)
+                {
+                    return DirectionalGap(from, m_contentRects[a], direction) < DirectionalGap(from, m_contentRects[b], direction);
+                });
+        }
+    }
+
+    m_metrics = std::move(metrics);
+}
+
 ScreenInfo::Snapshot::Snapshot(const std::vector<RECT>& rects, const RECT& clientRect) :
     m_contentRects{ rects },
     m_clientRect{ clientRect }
@@ -1,6 +1,8 @@
 #pragma once
 #include <vector>
 #include <tuple>
+#include <memory>
+#include "RegionMask.h"
 
 namespace dual_screen
 {
@@ -13,6 +15,14 @@ namespace dual_screen
         return std::tie(left.top, left.left) < std::tie(right.top, right.left);
     }
 
+    inline long long RectArea(const RECT& rect) { return static_cast<long long>(RectWidth(rect)) * RectHeight(rect); }
+
+    // Sorts the rects into logical order and collapses any that are smaller than
+    // 'minRectSize' into their neighbours (see ScreenInfo::SetMinRectSize).
+    void NormalizeContentRects(std::vector<RECT>& rects, int minRectSize);
+
+    class LayoutMap;
+
     // Kind of split between different regions.
     enum class SplitKind
     {
@@ -22,6 +32,15 @@ namespace dual_screen
         Horizontal
     };
 
+    // Direction to look in, relative to a region.
+    enum class RegionDirection
+    {
+        Left,
+        Up,
+        Right,
+        Down
+    };
+
     // ScreenInfo is a helper class that provides an abstraction over
     // the content rects API.
     struct ScreenInfo
@@ -29,6 +48,13 @@ namespace dual_screen
         class Snapshot;
 
         ScreenInfo();
+        ~ScreenInfo();
+
+        // Movable but not copyable, since it may own a LayoutMap (see UseLayoutMap).
+        ScreenInfo(ScreenInfo&&) noexcept;
+        ScreenInfo& operator=(ScreenInfo&&) noexcept;
+        ScreenInfo(const ScreenInfo&) = delete;
+        ScreenInfo& operator=(const ScreenInfo&) = delete;
 
         SplitKind GetSplitKind() const;
         RECT GetClientRect() const;
@@ -38,15 +64,59 @@ namespace dual_screen
         int GetIndexForRect(LPRECT rect) const;
         int GetWidestIndex() const;
         int GetTallestIndex() const;
+        int GetLargestIndex() const;
+
+        // Smallest rect containing every region, and the sum of their areas.
+        RECT GetBoundingRect() const;
+        long long GetTotalArea() const;
+
+        // Region indices, largest area first.
+        const std::vector<unsigned int>& GetIndicesByArea() const;
+
+        // The region containing 'point', or else the closest one; -1 if there are no regions.
+        // Unlike the queries above this isn't cached, since it depends on the point.
+        int GetNearestIndex(POINT point) const;
+
+        // Regions lying entirely on the given side of region 'index', closest first.
+        // Empty if 'index' is out of range.
+        const std::vector<unsigned int>& GetIndicesInDirection(unsigned int index, RegionDirection direction) const;
+
+        // Optional coverage for panels that aren't fully usable (rounded corners, camera
+        // cutouts, partially covered panels). 'panel' and 'usable' are in screen
+        // coordinates, since they describe the physical display; setting a mask for the
+        // same panel again replaces it. Any region on a masked panel gets a mask (in
+        // client coordinates) worked out from every panel it's on, which follows the
+        // window as it moves; the parts of a region on unmasked panels stay usable.
+        void SetPanelMask(const RECT& panel, const RegionMask& usable);
+        void ClearPanelMasks();
+
+        // False if the region is entirely usable.
+        bool HasRegionMask(unsigned int index) const;
+
+        // The region's mask, or the whole region if it doesn't have one.
+        RegionMask GetRegionMask(unsigned int index) const;
+
+        // The usable parts of the region as rects, for code that only deals in rects.
+        std::vector<RECT> GetRegionRects(unsigned int index) const;
 
         void SetMinRectSize(int minSize);
         int GetMinRectSize() const;
 
+        // Use a map of the current monitor layout, built up front, instead of enumerating
+        // the monitors on every Update. Call again (eg on WM_DISPLAYCHANGE) to rebuild it
+        // whenever the monitors change.
+        void UseLayoutMap(bool enable);
+        bool IsUsingLayoutMap() const;
+
         int GetBestIndexForHorizontalContent() const;
 
-        // Returns true if layout has materially changed.
+        // Returns true if layout has materially changed (including the usable parts of
+        // a region, if there are panel masks).
         bool Update(HWND hWnd) noexcept;
 
+        // Incremented every time Update reports a material change.
+        unsigned int GetGeneration() const;
+
         Snapshot GetSnapshot() const;
         bool HasConfigurationChanged(const Snapshot& other) const;
 
@@ -55,6 +125,9 @@ namespace dual_screen
 
         static bool AreMultipleScreensPresent();
 
+        // The monitor rects, in screen coordinates.
+        static std::vector<RECT> GetMonitorRects();
+
         class Snapshot
         {
             friend struct ScreenInfo;
@@ -72,12 +145,49 @@ namespace dual_screen
         SplitKind m_splitKind{ SplitKind::None };
         RECT m_clientRect{ 0 };
         RECT m_windowRect{ 0 };
+        POINT m_clientOrigin{ 0, 0 };
         std::vector<RECT> m_contentRects;
 
+        struct PanelMask
+        {
+            RECT panel;
+            RegionMask usable;
+        };
+
+        // Panel masks are in screen coordinates; the region masks worked out from them
+        // are in client coordinates, and null for regions that are entirely usable.
+        std::vector<PanelMask> m_panelMasks;
+        std::vector<std::shared_ptr<const RegionMask>> m_regionMasks;
+        bool UpdateRegionMasks();
+        bool FinishUpdate(bool changed, bool originMoved);
+
         // Default to "less than 200px is useless for layout" - can be overridden.
         int m_minSizeForRect{ 200 };
 
+        unsigned int m_generation{ 0 };
+
         int m_emulatedScreenCount{ -1 };
         bool ComputeEmulatedScreens(const Snapshot& snapshot);
+
+        std::unique_ptr<LayoutMap> m_layoutMap;
+        void EnumerateContentRects(HWND hWnd, std::vector<RECT>& rects) const;
+
+        // Metrics derived from the content rects; recomputed once whenever the rects
+        // change, so the queries above don't have to rescan the regions each time.
+        struct Metrics
+        {
+            int widest{ -1 };
+            int tallest{ -1 };
+            int largest{ -1 };
+            RECT bounds{ 0 };
+            long long totalArea{ 0 };
+            std::vector<unsigned int> byArea;
+
+            // GetIndicesInDirection for region i and direction d is entry 4 * i + d.
+            std::vector<std::vector<unsigned int>> inDirection;
+        };
+
+        Metrics m_metrics{};
+        void ComputeMetrics();
     };
 }
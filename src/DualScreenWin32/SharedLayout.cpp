@@ -0,0 +1,222 @@
+#include "stdafx.h"
+#include "SharedLayout.h"
+
+using namespace dual_screen;
+
+std::wstring dual_screen::GetSharedLayoutMutexName(const wchar_t* name)
+{
+    return std::wstring{ name } + L".Publisher";
+}
+
+SharedLayoutPublisher::~SharedLayoutPublisher()
+{
+    Close();
+}
+
+bool SharedLayoutPublisher::Create(const wchar_t* name)
+{
+    Close();
+
+    // Two writers would corrupt the seqlock, so whoever holds the mutex is the only
+    // publisher. It's abandoned (and so still ours to take) if the last one died.
+    m_mutex = CreateMutexW(nullptr, FALSE, GetSharedLayoutMutexName(name).c_str());
+    if (m_mutex == nullptr)
+    {
+        return false;
+    }
+
+    auto wait{ WaitForSingleObject(m_mutex, 0) };
+    if (wait != WAIT_OBJECT_0 && wait != WAIT_ABANDONED)
+    {
+        CloseHandle(m_mutex);
+        m_mutex = nullptr;
+        return false;
+    }
+
+    // The section may already exist if helpers kept it open; that's fine, it's ours now.
+    m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(SharedLayout), name);
+    if (m_mapping == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    m_layout = static_cast<SharedLayout*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedLayout)));
+    if (m_layout == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    // A new section starts out zeroed, which is a valid (empty, even) state. Readers
+    // check the header before trusting anything else.
+    m_layout->magic = SharedLayout::MAGIC;
+    m_layout->size = sizeof(SharedLayout);
+
+    // Announce the new publisher. Nothing's been published by it yet, so the old
+    // rects are dropped rather than left looking current.
+    BeginWrite();
+    m_layout->data.publisherProcessId = GetCurrentProcessId();
+    ++m_layout->data.publisherEpoch;
+    m_layout->data.rectCount = 0;
+    EndWrite();
+    return true;
+}
+
+void SharedLayoutPublisher::Close()
+{
+    if (m_layout != nullptr)
+    {
+        // Let helpers know nobody is publishing any more.
+        BeginWrite();
+        m_layout->data.publisherProcessId = 0;
+        EndWrite();
+
+        UnmapViewOfFile(m_layout);
+        m_layout = nullptr;
+    }
+
+    if (m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+
+    if (m_mutex != nullptr)
+    {
+        ReleaseMutex(m_mutex);
+        CloseHandle(m_mutex);
+        m_mutex = nullptr;
+    }
+}
+
+// Odd sequence number tells readers a write is in progress. A publisher that died
+// part way through a write leaves it odd, so round down before starting; the
+// sequence still ends up at a value readers haven't seen before.
+void SharedLayoutPublisher::BeginWrite()
+{
+    m_sequence = (m_layout->sequence.load(std::memory_order_relaxed) & ~1u) + 1;
+    m_layout->sequence.store(m_sequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void SharedLayoutPublisher::EndWrite()
+{
+    m_layout->sequence.store(m_sequence + 1, std::memory_order_release);
+}
+
+void SharedLayoutPublisher::Publish(const ScreenInfo& screenInfo)
+{
+    if (m_layout == nullptr)
+    {
+        return;
+    }
+
+    BeginWrite();
+
+    auto& data{ m_layout->data };
+    data.generation = screenInfo.GetGeneration();
+    data.splitKind = screenInfo.GetSplitKind();
+    data.clientRect = screenInfo.GetClientRect();
+    data.rectCount = screenInfo.GetRectCount();
+    if (data.rectCount > SharedLayoutData::MAX_RECTS)
+    {
+        data.rectCount = SharedLayoutData::MAX_RECTS;
+    }
+
+    for (unsigned int i = 0; i < data.rectCount; ++i)
+    {
+        data.rects[i] = screenInfo.GetRect(i);
+    }
+
+    EndWrite();
+}
+
+SharedLayoutReader::~SharedLayoutReader()
+{
+    Close();
+}
+
+bool SharedLayoutReader::Open(const wchar_t* name)
+{
+    Close();
+
+    m_mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, name);
+    if (m_mapping == nullptr)
+    {
+        return false;
+    }
+
+    m_layout = static_cast<const SharedLayout*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, sizeof(SharedLayout)));
+
+    // Refuse to read a section written by an incompatible publisher.
+    if (m_layout == nullptr || m_layout->magic != SharedLayout::MAGIC || m_layout->size != sizeof(SharedLayout))
+    {
+        Close();
+        return false;
+    }
+
+    m_mutexName = GetSharedLayoutMutexName(name);
+    return true;
+}
+
+void SharedLayoutReader::Close()
+{
+    if (m_layout != nullptr)
+    {
+        UnmapViewOfFile(m_layout);
+        m_layout = nullptr;
+    }
+
+    if (m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+}
+
+bool SharedLayoutReader::Read(SharedLayoutData& data) const
+{
+    if (m_layout == nullptr)
+    {
+        return false;
+    }
+
+    // Writes are tiny, so just spin (for a while) until we get a clean copy.
+    return ReadWithRetries([&data](const SharedLayoutData& shared) { data = shared; });
+}
+
+bool SharedLayoutReader::GetGeneration(unsigned int& generation) const
+{
+    if (m_layout == nullptr)
+    {
+        return false;
+    }
+
+    return ReadWithRetries([&generation](const SharedLayoutData& shared) { generation = shared.generation; });
+}
+
+bool SharedLayoutReader::IsPublisherRunning() const
+{
+    if (m_layout == nullptr)
+    {
+        return false;
+    }
+
+    // The publisher holds its mutex for as long as it's running, so if it can be
+    // taken (or it's gone altogether), nobody is publishing.
+    auto mutex{ OpenMutexW(SYNCHRONIZE, FALSE, m_mutexName.c_str()) };
+    if (mutex == nullptr)
+    {
+        return false;
+    }
+
+    auto wait{ WaitForSingleObject(mutex, 0) };
+    if (wait == WAIT_OBJECT_0 || wait == WAIT_ABANDONED)
+    {
+        ReleaseMutex(mutex);
+    }
+
+    CloseHandle(mutex);
+    return wait == WAIT_TIMEOUT;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include "ScreenInfo.h"
+
+namespace dual_screen
+{
+    // Default name of the shared-memory section the app publishes its layout to.
+    const wchar_t* const SHARED_LAYOUT_NAME{ L"Local\\DualScreenWin32.Layout" };
+
+    // The published layout, as plain data.
+    struct SharedLayoutData
+    {
+        static const unsigned int MAX_RECTS{ 16 };
+
+        // Which publisher wrote this: its process id (0 once it has closed), and an
+        // epoch that goes up every time a publisher takes the section over. Helpers
+        // that outlive the app can tell a restarted publisher from the old one.
+        unsigned int publisherProcessId;
+        unsigned int publisherEpoch;
+
+        unsigned int generation;
+        SplitKind splitKind;
+        RECT clientRect;
+        unsigned int rectCount;
+        RECT rects[MAX_RECTS];
+    };
+
+    // Fixed layout of the shared-memory section. Helper processes map it read-only
+    // and can look at it directly; 'sequence' is a seqlock (odd while the publisher
+    // is writing) that tells them whether what they read was consistent.
+    struct SharedLayout
+    {
+        static const unsigned int MAGIC{ 0x4C594F32 }; // 'LYO2'
+
+        std::atomic<unsigned int> sequence;
+        unsigned int magic;
+        unsigned int size;
+        SharedLayoutData data;
+    };
+
+    // Writes ScreenInfo snapshots into the shared section. Only one publisher at a time:
+    // a named mutex is held for as long as the section is open, so Create fails while
+    // another instance of the app is publishing under the same name. If the section
+    // is only still around because helpers have it open (eg the app restarted), the
+    // new publisher takes it over. Create and Close must be called on the same thread.
+    class SharedLayoutPublisher
+    {
+    public:
+        SharedLayoutPublisher() = default;
+        ~SharedLayoutPublisher();
+
+        SharedLayoutPublisher(const SharedLayoutPublisher&) = delete;
+        SharedLayoutPublisher& operator=(const SharedLayoutPublisher&) = delete;
+
+        bool Create(const wchar_t* name = SHARED_LAYOUT_NAME);
+        void Close();
+
+        // Any rects beyond SharedLayoutData::MAX_RECTS are dropped.
+        void Publish(const ScreenInfo& screenInfo);
+
+    private:
+        void BeginWrite();
+        void EndWrite();
+
+        HANDLE m_mutex{ nullptr };
+        HANDLE m_mapping{ nullptr };
+        SharedLayout* m_layout{ nullptr };
+        unsigned int m_sequence{ 0 };
+    };
+
+    // Name of the mutex a publisher holds while it owns the section called 'name'.
+    std::wstring GetSharedLayoutMutexName(const wchar_t* name);
+
+    // Reads snapshots published by a SharedLayoutPublisher, possibly in another process.
+    // Reads don't make any system calls; they just retry if they raced with a write.
+    class SharedLayoutReader
+    {
+    public:
+        SharedLayoutReader() = default;
+        ~SharedLayoutReader();
+
+        SharedLayoutReader(const SharedLayoutReader&) = delete;
+        SharedLayoutReader& operator=(const SharedLayoutReader&) = delete;
+
+        bool Open(const wchar_t* name = SHARED_LAYOUT_NAME);
+        void Close();
+
+        // Calls 'reader' with the live shared data. 'reader' may see a torn
+        // update, so it must not act on what it reads until TryRead returns true.
+        template<typename Func>
+        bool TryRead(Func&& reader) const
+        {
+            if (m_layout == nullptr)
+            {
+                return false;
+            }
+
+            auto before{ m_layout->sequence.load(std::memory_order_acquire) };
+            if (before & 1)
+            {
+                return false;
+            }
+
+            reader(m_layout->data);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return m_layout->sequence.load(std::memory_order_relaxed) == before;
+        }
+
+        // Copies a consistent snapshot into 'data', retrying while the publisher is
+        // writing. Returns false if nothing is mapped, or if the publisher never
+        // finished its write (eg it died part way through).
+        bool Read(SharedLayoutData& data) const;
+
+        // Cheap way to check whether anything has changed without copying the rects.
+        // Fails in the same cases as Read.
+        bool GetGeneration(unsigned int& generation) const;
+
+        // False if the publisher has closed or died, in which case the last snapshot
+        // is stale until a new publisher takes over (its epoch will be higher).
+        bool IsPublisherRunning() const;
+
+    private:
+        // A write takes well under a microsecond, so this many failed attempts means
+        // the publisher isn't coming back.
+        static const unsigned int MAX_READ_ATTEMPTS{ 100000 };
+
+        template<typename Func>
+        bool ReadWithRetries(Func&& reader) const
+        {
+            for (unsigned int attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt)
+            {
+                if (TryRead(reader))
+                {
+                    return true;
+                }
+
+                YieldProcessor();
+            }
+
+            return false;
+        }
+
+        HANDLE m_mapping{ nullptr };
+        const SharedLayout* m_layout{ nullptr };
+        std::wstring m_mutexName;
+    };
+}
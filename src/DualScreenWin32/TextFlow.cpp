@@ -0,0 +1,319 @@
+#include "stdafx.h"
+#include "TextFlow.h"
+#include "ScreenInfo.h"
+#include <algorithm>
+#include <climits>
+#include <utility>
+
+using namespace dual_screen;
+
+namespace
+{
+    const unsigned int NOT_EDITED{ UINT_MAX };
+}
+
+TextFlow::TextFlow(MeasureFunc measure, void* context, int lineHeight) :
+    m_measure{ measure },
+    m_context{ context },
+    m_lineHeight{ std::max(1, lineHeight) },
+    m_firstEdited{ NOT_EDITED }
+{
+}
+
+void TextFlow::SetParagraphs(const std::vector<std::wstring>& paragraphs)
+{
+    m_paragraphs.clear();
+    m_paragraphs.resize(paragraphs.size());
+    for (unsigned int i = 0; i < paragraphs.size(); ++i)
+    {
+        m_paragraphs[i].text = paragraphs[i];
+    }
+
+    // A whole new document; forget the previous layout.
+    m_regions.clear();
+    m_regionStarts.clear();
+    m_regionFirstLines.clear();
+    m_lines.clear();
+    m_firstEdited = NOT_EDITED;
+}
+
+void TextFlow::SetParagraph(unsigned int index, const std::wstring& text)
+{
+    if (index >= m_paragraphs.size())
+    {
+        return;
+    }
+
+    m_paragraphs[index] = Paragraph{};
+    m_paragraphs[index].text = text;
+    m_firstEdited = std::min(m_firstEdited, index);
+}
+
+unsigned int TextFlow::GetParagraphCount() const
+{
+    return static_cast<unsigned int>(m_paragraphs.size());
+}
+
+const std::wstring& TextFlow::GetParagraph(unsigned int index) const
+{
+    return m_paragraphs[index].text;
+}
+
+void TextFlow::SetLineHeight(int lineHeight)
+{
+    m_lineHeight = std::max(1, lineHeight);
+    m_spaceWidth = -1;
+
+    for (auto& paragraph : m_paragraphs)
+    {
+        auto text{ std::move(paragraph.text) };
+        paragraph = Paragraph{};
+        paragraph.text = std::move(text);
+    }
+
+    m_regions.clear();
+    m_regionStarts.clear();
+    m_regionFirstLines.clear();
+    m_lines.clear();
+}
+
+void TextFlow::Reflow(const std::vector<RECT>& regions)
+{
+    m_stats = {};
+
+    // Regions before the first one that changed size keep their lines as they are.
+    auto oldCount{ static_cast<unsigned int>(m_regions.size()) };
+    unsigned int first{ 0 };
+    while (first < regions.size() && first < oldCount &&
+        RectWidth(regions[first]) == RectWidth(m_regions[first]) &&
+        RectHeight(regions[first]) == RectHeight(m_regions[first]))
+    {
+        ++first;
+    }
+
+    // An edit only matters from the region where the edited paragraph starts, and
+    // not at all if the paragraph wasn't showing.
+    if (m_firstEdited != NOT_EDITED && oldCount > 0 && m_firstEdited <= m_regionStarts[oldCount].paragraph)
+    {
+        unsigned int editedRegion{ 0 };
+        for (unsigned int i = 0; i < oldCount; ++i)
+        {
+            const auto& start{ m_regionStarts[i] };
+            if (start.paragraph > m_firstEdited || (start.paragraph == m_firstEdited && start.offset > 0))
+            {
+                break;
+            }
+
+            editedRegion = i;
+        }
+
+        first = std::min(first, editedRegion);
+    }
+
+    m_firstEdited = NOT_EDITED;
+
+    Cursor cursor{};
+    if (first < oldCount)
+    {
+        cursor = m_regionStarts[first];
+        m_lines.resize(m_regionFirstLines[first]);
+    }
+    else if (oldCount > 0)
+    {
+        cursor = m_regionStarts[oldCount];
+    }
+    else
+    {
+        m_lines.clear();
+    }
+
+    m_stats.firstRegion = first;
+
+    m_regions = regions;
+    m_regionStarts.resize(first);
+    m_regionFirstLines.resize(first);
+
+    for (unsigned int i = first; i < m_regions.size(); ++i)
+    {
+        m_regionStarts.push_back(cursor);
+        m_regionFirstLines.push_back(static_cast<unsigned int>(m_lines.size()));
+        cursor = LayoutRegion(i, cursor);
+    }
+
+    // One extra entry so that the end of the last region is known too.
+    m_regionStarts.push_back(cursor);
+    m_regionFirstLines.push_back(static_cast<unsigned int>(m_lines.size()));
+}
+
+const std::vector<TextFlow::Line>& TextFlow::GetLines() const
+{
+    return m_lines;
+}
+
+void TextFlow::GetRegionLines(unsigned int region, unsigned int& first, unsigned int& count) const
+{
+    if (region + 1 >= m_regionFirstLines.size())
+    {
+        first = count = 0;
+        return;
+    }
+
+    first = m_regionFirstLines[region];
+    count = m_regionFirstLines[region + 1] - first;
+}
+
+RECT TextFlow::GetRegion(unsigned int region) const
+{
+    return m_regions[region];
+}
+
+TextFlow::Stats TextFlow::GetLastStats() const
+{
+    return m_stats;
+}
+
+// Splits the paragraph into words and measures each of them, once.
+void TextFlow::Measure(Paragraph& paragraph)
+{
+    if (m_spaceWidth < 0)
+    {
+        m_spaceWidth = m_measure(m_context, L" ", 1);
+    }
+
+    const auto& text{ paragraph.text };
+    auto length{ static_cast<unsigned int>(text.size()) };
+
+    paragraph.words.clear();
+    unsigned int i{ 0 };
+    while (i < length)
+    {
+        while (i < length && text[i] == L' ')
+        {
+            ++i;
+        }
+
+        auto start{ i };
+        while (i < length && text[i] != L' ')
+        {
+            ++i;
+        }
+
+        if (i > start)
+        {
+            paragraph.words.push_back({ start, i - start, m_measure(m_context, text.c_str() + start, static_cast<int>(i - start)) });
+        }
+    }
+
+    paragraph.measured = true;
+}
+
+const std::vector<TextFlow::Break>& TextFlow::GetBreaks(Paragraph& paragraph, int width)
+{
+    if (paragraph.cache[0].width == width)
+    {
+        return paragraph.cache[0].breaks;
+    }
+
+    if (paragraph.cache[1].width == width)
+    {
+        std::swap(paragraph.cache[0], paragraph.cache[1]);
+        return paragraph.cache[0].breaks;
+    }
+
+    // Evict the least recently used width.
+    std::swap(paragraph.cache[0], paragraph.cache[1]);
+    paragraph.cache[0].width = width;
+    ComputeBreaks(paragraph, width, 0, paragraph.cache[0].breaks);
+    ++m_stats.breaksComputed;
+
+    return paragraph.cache[0].breaks;
+}
+
+// Greedy line breaking: as many words as fit, but always at least one per line.
+void TextFlow::ComputeBreaks(const Paragraph& paragraph, int width, unsigned int fromOffset, std::vector<Break>& breaks) const
+{
+    breaks.clear();
+
+    const auto& words{ paragraph.words };
+    auto i{ static_cast<unsigned int>(std::lower_bound(std::begin(words), std::end(words), fromOffset,
+        [](const Word& w, unsigned int offset) { return w.start < offset; }) - std::begin(words)) };
+
+    // An empty paragraph still takes up a (blank) line.
+    if (words.empty())
+    {
+        breaks.push_back({ 0, 0 });
+        return;
+    }
+
+    while (i < words.size())
+    {
+        auto lineWidth{ words[i].width };
+        auto j{ i + 1 };
+        while (j < words.size() && lineWidth + m_spaceWidth + words[j].width <= width)
+        {
+            lineWidth += m_spaceWidth + words[j].width;
+            ++j;
+        }
+
+        breaks.push_back({ words[i].start, words[j - 1].start + words[j - 1].length - words[i].start });
+        i = j;
+    }
+}
+
+// Fills one region with lines, starting at 'cursor'; returns where the next region
+// should carry on from.
+TextFlow::Cursor TextFlow::LayoutRegion(unsigned int region, Cursor cursor)
+{
+    auto width{ RectWidth(m_regions[region]) };
+    auto height{ RectHeight(m_regions[region]) };
+    if (width <= 0)
+    {
+        return cursor;
+    }
+
+    int y{ 0 };
+    while (cursor.paragraph < m_paragraphs.size() && y + m_lineHeight <= height)
+    {
+        auto& paragraph{ m_paragraphs[cursor.paragraph] };
+        if (!paragraph.measured)
+        {
+            Measure(paragraph);
+        }
+
+        const auto* breaks{ &GetBreaks(paragraph, width) };
+        auto index{ static_cast<unsigned int>(std::lower_bound(std::begin(*breaks), std::end(*breaks), cursor.offset,
+            [](const Break& b, unsigned int offset) { return b.start < offset; }) - std::begin(*breaks)) };
+
+        // Carrying on a paragraph from a region of a different width; the cached breaks
+        // don't line up, so break the rest of it on the spot.
+        if (cursor.offset > 0 && (index >= breaks->size() || (*breaks)[index].start != cursor.offset))
+        {
+            ComputeBreaks(paragraph, width, cursor.offset, m_scratch);
+            ++m_stats.breaksComputed;
+            breaks = &m_scratch;
+            index = 0;
+        }
+
+        for (; index < breaks->size() && y + m_lineHeight <= height; ++index)
+        {
+            const auto& b{ (*breaks)[index] };
+            m_lines.push_back({ region, y, cursor.paragraph, b.start, b.length });
+            y += m_lineHeight;
+            ++m_stats.linesPlaced;
+        }
+
+        if (index < breaks->size())
+        {
+            // Out of room part way through the paragraph.
+            cursor.offset = (*breaks)[index].start;
+            break;
+        }
+
+        // Half a line between paragraphs.
+        ++cursor.paragraph;
+        cursor.offset = 0;
+        y += m_lineHeight / 2;
+    }
+
+    return cursor;
+}
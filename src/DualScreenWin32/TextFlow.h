@@ -0,0 +1,121 @@
+#pragma once
+#include <vector>
+#include <string>
+
+namespace dual_screen
+{
+    // TextFlow lays out paragraphs of text as columns across the content regions, in
+    // region order, so a document reads from one screen to the next without ever
+    // running across the hinge.
+    //
+    // Word widths are measured once per paragraph and line breaks are cached per
+    // paragraph and width. When the regions change, only the regions from the first
+    // one that actually changed size are laid out again; regions that merely moved
+    // keep their lines (which are stored relative to the region).
+    class TextFlow
+    {
+    public:
+        // Returns the width in pixels of 'length' characters of 'text'.
+        using MeasureFunc = int (*)(void* context, const wchar_t* text, int length);
+
+        struct Line
+        {
+            unsigned int region;
+            int y;                  // Relative to the top of the region
+            unsigned int paragraph;
+            unsigned int start;     // Character range within the paragraph
+            unsigned int length;
+        };
+
+        struct Stats
+        {
+            unsigned int firstRegion{ 0 };      // First region that was laid out again
+            unsigned int linesPlaced{ 0 };
+            unsigned int breaksComputed{ 0 };   // Line-break cache misses
+        };
+
+        TextFlow(MeasureFunc measure, void* context, int lineHeight);
+
+        void SetParagraphs(const std::vector<std::wstring>& paragraphs);
+        void SetParagraph(unsigned int index, const std::wstring& text);
+        unsigned int GetParagraphCount() const;
+        const std::wstring& GetParagraph(unsigned int index) const;
+
+        // Call after the font changes; everything has to be measured again.
+        void SetLineHeight(int lineHeight);
+
+        // Flows the text into 'regions'. Text that doesn't fit is left out.
+        void Reflow(const std::vector<RECT>& regions);
+
+        const std::vector<Line>& GetLines() const;
+
+        // Lines [first, first + count) of GetLines() are in 'region'.
+        void GetRegionLines(unsigned int region, unsigned int& first, unsigned int& count) const;
+        RECT GetRegion(unsigned int region) const;
+
+        Stats GetLastStats() const;
+
+    private:
+        struct Word
+        {
+            unsigned int start;
+            unsigned int length;
+            int width;
+        };
+
+        struct Break
+        {
+            unsigned int start;
+            unsigned int length;
+        };
+
+        struct Paragraph
+        {
+            std::wstring text;
+            bool measured{ false };
+            std::vector<Word> words;
+
+            // Most recently used widths first; two covers the usual dual-screen case
+            // of two different region widths.
+            struct CachedBreaks
+            {
+                int width{ -1 };
+                std::vector<Break> breaks;
+            };
+
+            CachedBreaks cache[2];
+        };
+
+        // Where the text continues from: a paragraph and a character offset into it.
+        struct Cursor
+        {
+            unsigned int paragraph{ 0 };
+            unsigned int offset{ 0 };
+        };
+
+        void Measure(Paragraph& paragraph);
+        const std::vector<Break>& GetBreaks(Paragraph& paragraph, int width);
+        void ComputeBreaks(const Paragraph& paragraph, int width, unsigned int fromOffset, std::vector<Break>& breaks) const;
+        Cursor LayoutRegion(unsigned int region, Cursor cursor);
+
+        MeasureFunc m_measure;
+        void* m_context;
+        int m_lineHeight;
+        int m_spaceWidth{ -1 };
+
+        std::vector<Paragraph> m_paragraphs;
+
+        // Regions from the last Reflow, where each one's text started (plus one extra
+        // for where the last one ended), and the index of each one's first line.
+        std::vector<RECT> m_regions;
+        std::vector<Cursor> m_regionStarts;
+        std::vector<unsigned int> m_regionFirstLines;
+        std::vector<Line> m_lines;
+
+        // Lowest paragraph edited since the last Reflow, if any.
+        unsigned int m_firstEdited;
+
+        std::vector<Break> m_scratch;
+        Stats m_stats{};
+    };
+}
@@ -0,0 +1,290 @@
+#include "stdafx.h"
+#include "TiledRenderer.h"
+#include <algorithm>
+
+using namespace dual_screen;
+
+namespace
+{
+    // COLORREF is 0x00BBGGRR, DIB pixels are 0x00RRGGBB.
+    UINT32 ToPixel(COLORREF color)
+    {
+        return (GetRValue(color) << 16) | (GetGValue(color) << 8) | GetBValue(color);
+    }
+
+    RECT ClipToSurface(const PixelSurface& surface, const RECT& rect)
+    {
+        RECT bounds{ 0, 0, surface.width, surface.height };
+        RECT clipped{};
+        IntersectRect(&clipped, &bounds, &rect);
+        return clipped;
+    }
+}
+
+void dual_screen::FillPixels(const PixelSurface& surface, const RECT& rect, COLORREF color)
+{
+    FillPixels(surface, rect, color, RECT{ 0, 0, surface.width, surface.height });
+}
+
+void dual_screen::FillPixels(const PixelSurface& surface, const RECT& rect, COLORREF color, const RECT& clip)
+{
+    auto clipped{ ClipToSurface(surface, rect) };
+    IntersectRect(&clipped, &clipped, &clip);
+    auto pixel{ ToPixel(color) };
+
+    for (LONG y = clipped.top; y < clipped.bottom; ++y)
+    {
+        auto row{ surface.pixels + static_cast<size_t>(y) * surface.width };
+        std::fill(row + clipped.left, row + clipped.right, pixel);
+    }
+}
+
+void dual_screen::FramePixels(const PixelSurface& surface, const RECT& rect, COLORREF color)
+{
+    FramePixels(surface, rect, color, RECT{ 0, 0, surface.width, surface.height });
+}
+
+void dual_screen::FramePixels(const PixelSurface& surface, const RECT& rect, COLORREF color, const RECT& clip)
+{
+    if (IsRectEmpty(&rect))
+    {
+        return;
+    }
+
+    FillPixels(surface, RECT{ rect.left, rect.top, rect.right, rect.top + 1 }, color, clip);
+    FillPixels(surface, RECT{ rect.left, rect.bottom - 1, rect.right, rect.bottom }, color, clip);
+    FillPixels(surface, RECT{ rect.left, rect.top, rect.left + 1, rect.bottom }, color, clip);
+    FillPixels(surface, RECT{ rect.right - 1, rect.top, rect.right, rect.bottom }, color, clip);
+}
+
+TiledRenderer::TiledRenderer(unsigned int maxThreads)
+{
+    m_pool = CreateThreadpool(nullptr);
+
+    InitializeThreadpoolEnvironment(&m_environment);
+    if (m_pool != nullptr)
+    {
+        SetThreadpoolCallbackPool(&m_environment, m_pool);
+        m_work = CreateThreadpoolWork(WorkCallback, this, &m_environment);
+    }
+
+    SetMaxThreads(maxThreads);
+}
+
+TiledRenderer::~TiledRenderer()
+{
+    if (m_work != nullptr)
+    {
+        WaitForThreadpoolWorkCallbacks(m_work, FALSE);
+        CloseThreadpoolWork(m_work);
+    }
+
+    if (m_pool != nullptr)
+    {
+        CloseThreadpool(m_pool);
+    }
+
+    DestroyThreadpoolEnvironment(&m_environment);
+    ReleaseFramebuffer();
+}
+
+void TiledRenderer::SetMaxThreads(unsigned int maxThreads)
+{
+    if (maxThreads == 0)
+    {
+        SYSTEM_INFO info{};
+        GetSystemInfo(&info);
+        maxThreads = std::max<unsigned int>(1, info.dwNumberOfProcessors);
+    }
+
+    m_maxThreads = maxThreads;
+
+    // The UI thread draws tiles too, so the pool only needs the rest.
+    if (m_pool != nullptr)
+    {
+        SetThreadpoolThreadMaximum(m_pool, std::max<unsigned int>(1, maxThreads - 1));
+        SetThreadpoolThreadMinimum(m_pool, 1);
+    }
+}
+
+unsigned int TiledRenderer::GetMaxThreads() const
+{
+    return m_maxThreads;
+}
+
+void TiledRenderer::SetBackgroundColor(COLORREF color)
+{
+    // Callers set this every frame; the gaps only need redoing if it actually changed.
+    if (color != m_background)
+    {
+        m_background = color;
+        m_gapsValid = false;
+    }
+}
+
+bool TiledRenderer::Resize(HDC reference, int width, int height)
+{
+    if (m_dc != nullptr && width == m_surface.width && height == m_surface.height)
+    {
+        return true;
+    }
+
+    ReleaseFramebuffer();
+    if (width <= 0 || height <= 0)
+    {
+        return false;
+    }
+
+    BITMAPINFO info{};
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height; // top-down
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    void* bits{ nullptr };
+    m_dc = CreateCompatibleDC(reference);
+    m_bitmap = CreateDIBSection(reference, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+    if (m_dc == nullptr || m_bitmap == nullptr)
+    {
+        ReleaseFramebuffer();
+        return false;
+    }
+
+    m_oldBitmap = SelectObject(m_dc, m_bitmap);
+    m_surface.pixels = static_cast<UINT32*>(bits);
+    m_surface.width = width;
+    m_surface.height = height;
+    m_gapsValid = false;
+
+    return true;
+}
+
+unsigned int TiledRenderer::Render(const ScreenInfo& screenInfo, TileCallback callback, void* context)
+{
+    if (m_dc == nullptr)
+    {
+        return 0;
+    }
+
+    // GDI may have been drawing into the DIB; make sure it's done before we touch the bits.
+    GdiFlush();
+
+    if (!m_gapsValid || m_gapsGeneration != screenInfo.GetGeneration())
+    {
+        ClearGaps(screenInfo);
+        m_gapsValid = true;
+        m_gapsGeneration = screenInfo.GetGeneration();
+    }
+
+    // Masked regions become several tiles, none of which cover the unusable parts.
+    m_tiles.clear();
+    for (unsigned int i = 0; i < screenInfo.GetRectCount(); ++i)
+    {
+        for (const auto& rect : screenInfo.GetRegionRects(i))
+        {
+            auto tile{ ClipToSurface(m_surface, rect) };
+            if (!IsRectEmpty(&tile))
+            {
+                m_tiles.push_back({ i, tile });
+            }
+        }
+    }
+
+    m_callback = callback;
+    m_context = context;
+    m_nextTile = 0;
+
+    auto helpers{ std::min<unsigned int>(static_cast<unsigned int>(m_tiles.size()), m_maxThreads) };
+    if (m_work != nullptr)
+    {
+        for (unsigned int i = 1; i < helpers; ++i)
+        {
+            SubmitThreadpoolWork(m_work);
+        }
+    }
+
+    RenderTiles();
+
+    if (m_work != nullptr)
+    {
+        WaitForThreadpoolWorkCallbacks(m_work, FALSE);
+    }
+
+    return static_cast<unsigned int>(m_tiles.size());
+}
+
+HDC TiledRenderer::GetDC() const
+{
+    return m_dc;
+}
+
+PixelSurface TiledRenderer::GetSurface() const
+{
+    return m_surface;
+}
+
+void TiledRenderer::Present(HDC target, const RECT& rect) const
+{
+    if (m_dc != nullptr)
+    {
+        BitBlt(target, rect.left, rect.top, RectWidth(rect), RectHeight(rect), m_dc, rect.left, rect.top, SRCCOPY);
+    }
+}
+
+void CALLBACK TiledRenderer::WorkCallback(PTP_CALLBACK_INSTANCE, PVOID context, PTP_WORK)
+{
+    static_cast<TiledRenderer*>(context)->RenderTiles();
+}
+
+// Every thread (including the caller) keeps claiming tiles until there are none left.
+void TiledRenderer::RenderTiles()
+{
+    auto count{ static_cast<LONG>(m_tiles.size()) };
+
+    LONG index;
+    while ((index = InterlockedIncrement(&m_nextTile) - 1) < count)
+    {
+        const auto& tile{ m_tiles[index] };
+        m_callback(m_context, tile.regionIndex, tile.rect, m_surface);
+    }
+}
+
+void TiledRenderer::ReleaseFramebuffer()
+{
+    if (m_dc != nullptr && m_oldBitmap != nullptr)
+    {
+        SelectObject(m_dc, m_oldBitmap);
+    }
+
+    if (m_bitmap != nullptr)
+    {
+        DeleteObject(m_bitmap);
+    }
+
+    if (m_dc != nullptr)
+    {
+        DeleteDC(m_dc);
+    }
+
+    m_dc = nullptr;
+    m_bitmap = nullptr;
+    m_oldBitmap = nullptr;
+    m_surface = PixelSurface{};
+}
+
+// Whatever isn't covered by (the usable part of) a region is background.
+void TiledRenderer::ClearGaps(const ScreenInfo& screenInfo)
+{
+    RegionMask gaps{ RECT{ 0, 0, m_surface.width, m_surface.height } };
+    for (unsigned int i = 0; i < screenInfo.GetRectCount(); ++i)
+    {
+        gaps = gaps.Subtract(screenInfo.GetRegionMask(i));
+    }
+
+    for (const auto& rect : gaps.ToRects())
+    {
+        FillPixels(m_surface, rect, m_background);
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <vector>
+#include "ScreenInfo.h"
+
+namespace dual_screen
+{
+    // A view of 32bpp (0x00RRGGBB) pixels, top row first.
+    struct PixelSurface
+    {
+        UINT32* pixels{ nullptr };
+        int width{ 0 };
+        int height{ 0 };
+    };
+
+    // Simple software drawing; 'rect' is clipped to the surface, and to 'clip' if given.
+    void FillPixels(const PixelSurface& surface, const RECT& rect, COLORREF color);
+    void FillPixels(const PixelSurface& surface, const RECT& rect, COLORREF color, const RECT& clip);
+    void FramePixels(const PixelSurface& surface, const RECT& rect, COLORREF color);
+    void FramePixels(const PixelSurface& surface, const RECT& rect, COLORREF color, const RECT& clip);
+
+    // TiledRenderer draws a frame as tiles covering the usable part of each content
+    // region (one tile per region, unless the region has a mask), in parallel on a
+    // thread pool, into a software framebuffer. Regions never overlap, so tiles can
+    // be drawn independently; gaps between regions aren't tiled at all and are only
+    // cleared when the layout changes. The finished frame is presented with a
+    // single blit.
+    //
+    // The framebuffer is a DIB section, so GDI can still be used (from one thread)
+    // for things like text once the tiles are done.
+    class TiledRenderer
+    {
+    public:
+        // Called on a pool thread for each tile; must only touch pixels inside 'tile',
+        // and shouldn't read UI-thread state other than through 'context'.
+        using TileCallback = void (*)(void* context, unsigned int regionIndex, const RECT& tile, const PixelSurface& surface);
+
+        // 'maxThreads' of 0 means one per processor.
+        explicit TiledRenderer(unsigned int maxThreads = 0);
+        ~TiledRenderer();
+
+        TiledRenderer(const TiledRenderer&) = delete;
+        TiledRenderer& operator=(const TiledRenderer&) = delete;
+
+        void SetMaxThreads(unsigned int maxThreads);
+        unsigned int GetMaxThreads() const;
+
+        void SetBackgroundColor(COLORREF color);
+
+        // (Re)creates the framebuffer if the size changed.
+        bool Resize(HDC reference, int width, int height);
+
+        // Draws every non-empty tile and returns the number of tiles drawn.
+        unsigned int Render(const ScreenInfo& screenInfo, TileCallback callback, void* context);
+
+        HDC GetDC() const;
+        PixelSurface GetSurface() const;
+
+        // Copies 'rect' of the frame to the target.
+        void Present(HDC target, const RECT& rect) const;
+
+    private:
+        static void CALLBACK WorkCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WORK work);
+        void RenderTiles();
+        void ReleaseFramebuffer();
+        void ClearGaps(const ScreenInfo& screenInfo);
+
+        PTP_POOL m_pool{ nullptr };
+        TP_CALLBACK_ENVIRON m_environment{};
+        PTP_WORK m_work{ nullptr };
+        unsigned int m_maxThreads{ 0 };
+
+        HDC m_dc{ nullptr };
+        HBITMAP m_bitmap{ nullptr };
+        HGDIOBJ m_oldBitmap{ nullptr };
+        PixelSurface m_surface{};
+        COLORREF m_background{ RGB(255, 255, 255) };
+
+        // Gaps only need clearing when the layout (or framebuffer) changes.
+        bool m_gapsValid{ false };
+        unsigned int m_gapsGeneration{ 0 };
+
+        // State for the frame currently being rendered.
+        struct Tile
+        {
+            unsigned int regionIndex;
+            RECT rect;
+        };
+
+        std::vector<Tile> m_tiles;
+        volatile LONG m_nextTile{ 0 };
+        TileCallback m_callback{ nullptr };
+        void* m_context{ nullptr };
+    };
+}
@@ -0,0 +1,244 @@
+#include "stdafx.h"
+#include "WindowGeometry.h"
+#include "ScreenInfo.h"
+#include <algorithm>
+
+using namespace dual_screen;
+
+namespace
+{
+    const UINT MOVE_FLAGS{ SWP_NOZORDER | SWP_NOACTIVATE | SWP_NOOWNERZORDER };
+}
+
+void DeferredGeometryBackend::Begin(unsigned int moveCount)
+{
+    m_queued.clear();
+    m_succeeded = true;
+    m_deferred = BeginDeferWindowPos(static_cast<int>(moveCount));
+}
+
+bool DeferredGeometryBackend::Move(HWND window, const RECT& rect)
+{
+    m_queued.push_back({ window, rect });
+
+    // Couldn't start a batch, or an earlier move already lost it.
+    if (m_deferred == nullptr)
+    {
+        return MoveDirectly(m_queued.back());
+    }
+
+    auto deferred{ DeferWindowPos(m_deferred, window, nullptr, rect.left, rect.top,
+        RectWidth(rect), RectHeight(rect), MOVE_FLAGS) };
+    if (deferred == nullptr)
+    {
+        // DeferWindowPos throws away the whole batch when it fails, including the
+        // moves that were already queued.
+        m_deferred = nullptr;
+        ReplayDirectly();
+        return m_succeeded;
+    }
+
+    m_deferred = deferred;
+    return true;
+}
+
+bool DeferredGeometryBackend::End()
+{
+    if (m_deferred != nullptr)
+    {
+        if (!EndDeferWindowPos(m_deferred))
+        {
+            ReplayDirectly();
+        }
+
+        m_deferred = nullptr;
+    }
+
+    m_queued.clear();
+    return m_succeeded;
+}
+
+bool DeferredGeometryBackend::MoveDirectly(const QueuedMove& move)
+{
+    const auto& rect{ move.rect };
+    if (!SetWindowPos(move.window, nullptr, rect.left, rect.top, RectWidth(rect), RectHeight(rect), MOVE_FLAGS))
+    {
+        m_succeeded = false;
+        return false;
+    }
+
+    return true;
+}
+
+void DeferredGeometryBackend::ReplayDirectly()
+{
+    for (const auto& move : m_queued)
+    {
+        MoveDirectly(move);
+    }
+}
+
+void RecordingGeometryBackend::Begin(unsigned int)
+{
+    ++m_batchCount;
+}
+
+bool RecordingGeometryBackend::Move(HWND window, const RECT& rect)
+{
+    m_moves.push_back({ window, rect });
+    return true;
+}
+
+bool RecordingGeometryBackend::End()
+{
+    return true;
+}
+
+const std::vector<RecordingGeometryBackend::RecordedMove>& RecordingGeometryBackend::GetMoves() const
+{
+    return m_moves;
+}
+
+unsigned int RecordingGeometryBackend::GetBatchCount() const
+{
+    return m_batchCount;
+}
+
+void RecordingGeometryBackend::Clear()
+{
+    m_moves.clear();
+    m_batchCount = 0;
+}
+
+WindowGeometry::WindowGeometry() :
+    m_backend{ m_defaultBackend }
+{
+}
+
+WindowGeometry::WindowGeometry(GeometryBackend& backend) :
+    m_backend{ backend }
+{
+}
+
+void WindowGeometry::SetTarget(HWND window, const RECT& rect)
+{
+    auto existing{ Find(m_pending, window) };
+    if (existing != nullptr)
+    {
+        existing->rect = rect;
+    }
+    else
+    {
+        m_pending.push_back({ window, rect });
+    }
+}
+
+WindowGeometry::CommitResult WindowGeometry::Commit()
+{
+    m_lastResult = {};
+    m_changes.clear();
+
+    for (const auto& target : m_pending)
+    {
+        auto committed{ Find(m_committed, target.window) };
+        if (committed != nullptr && EqualRect(&committed->rect, &target.rect))
+        {
+            ++m_lastResult.skipped;
+            continue;
+        }
+
+        m_changes.push_back(target);
+    }
+
+    m_pending.clear();
+
+    // Don't bother starting a batch if nothing actually moved.
+    if (m_changes.empty())
+    {
+        m_totals.skipped += m_lastResult.skipped;
+        return m_lastResult;
+    }
+
+    m_backend.Begin(static_cast<unsigned int>(m_changes.size()));
+    for (const auto& change : m_changes)
+    {
+        m_backend.Move(change.window, change.rect);
+    }
+
+    // Only remember what was committed once the backend says it actually happened;
+    // otherwise the next Commit would skip windows that never moved.
+    if (m_backend.End())
+    {
+        for (const auto& change : m_changes)
+        {
+            auto committed{ Find(m_committed, change.window) };
+            if (committed != nullptr)
+            {
+                committed->rect = change.rect;
+            }
+            else
+            {
+                m_committed.push_back(change);
+            }
+        }
+
+        m_lastResult.applied = static_cast<unsigned int>(m_changes.size());
+    }
+    else
+    {
+        // Some windows may have moved, but we can't tell which; try them all again next time.
+        for (const auto& change : m_changes)
+        {
+            Invalidate(change.window);
+        }
+
+        m_lastResult.failed = static_cast<unsigned int>(m_changes.size());
+    }
+
+    m_totals.applied += m_lastResult.applied;
+    m_totals.skipped += m_lastResult.skipped;
+    m_totals.failed += m_lastResult.failed;
+
+    return m_lastResult;
+}
+
+void WindowGeometry::Invalidate(HWND window)
+{
+    auto end = std::remove_if(std::begin(m_committed), std::end(m_committed), [window](const auto& e)
+        {
+            return e.window == window;
+        });
+
+    m_committed.erase(end, std::end(m_committed));
+}
+
+void WindowGeometry::InvalidateAll()
+{
+    m_committed.clear();
+}
+
+WindowGeometry::CommitResult WindowGeometry::GetLastCommitResult() const
+{
+    return m_lastResult;
+}
+
+WindowGeometry::CommitResult WindowGeometry::GetTotals() const
+{
+    return m_totals;
+}
+
+// There are only ever a handful of child windows, so a linear search beats a map.
+WindowGeometry::Entry* WindowGeometry::Find(std::vector<Entry>& entries, HWND window)
+{
+    auto result = std::find_if(std::begin(entries), std::end(entries), [window](const auto& e)
+        {
+            return e.window == window;
+        });
+
+    if (result == std::end(entries))
+    {
+        return nullptr;
+    }
+
+    return &*result;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <vector>
+
+namespace dual_screen
+{
+    // Applies a batch of window moves. The default backend uses DeferWindowPos so
+    // the whole batch is repositioned (and repainted) in one go.
+    //
+    // Move returns false if that move could not be made; End returns true only if
+    // every move in the batch was.
+    class GeometryBackend
+    {
+    public:
+        virtual ~GeometryBackend() = default;
+
+        virtual void Begin(unsigned int moveCount) = 0;
+        virtual bool Move(HWND window, const RECT& rect) = 0;
+        virtual bool End() = 0;
+    };
+
+    // If the deferred batch can't be built or applied, every move in it is made
+    // again, one at a time, with SetWindowPos.
+    class DeferredGeometryBackend : public GeometryBackend
+    {
+    public:
+        void Begin(unsigned int moveCount) override;
+        bool Move(HWND window, const RECT& rect) override;
+        bool End() override;
+
+    private:
+        struct QueuedMove
+        {
+            HWND window;
+            RECT rect;
+        };
+
+        bool MoveDirectly(const QueuedMove& move);
+        void ReplayDirectly();
+
+        HDWP m_deferred{ nullptr };
+        std::vector<QueuedMove> m_queued;
+        bool m_succeeded{ true };
+    };
+
+    // Remembers the moves instead of making them, so layout code can be exercised
+    // without any real windows.
+    class RecordingGeometryBackend : public GeometryBackend
+    {
+    public:
+        struct RecordedMove
+        {
+            HWND window;
+            RECT rect;
+        };
+
+        void Begin(unsigned int moveCount) override;
+        bool Move(HWND window, const RECT& rect) override;
+        bool End() override;
+
+        const std::vector<RecordedMove>& GetMoves() const;
+        unsigned int GetBatchCount() const;
+        void Clear();
+
+    private:
+        std::vector<RecordedMove> m_moves;
+        unsigned int m_batchCount{ 0 };
+    };
+
+    // WindowGeometry collects the target rects for child windows and, on Commit,
+    // only moves the ones that differ from what was last committed. A batch that
+    // the backend couldn't apply isn't remembered as committed, so the next Commit
+    // tries those windows again.
+    class WindowGeometry
+    {
+    public:
+        struct CommitResult
+        {
+            unsigned int applied{ 0 };
+            unsigned int skipped{ 0 };
+            unsigned int failed{ 0 };
+        };
+
+        // Uses a DeferredGeometryBackend unless one is supplied. The backend must
+        // outlive this object.
+        WindowGeometry();
+        explicit WindowGeometry(GeometryBackend& backend);
+
+        // Queues a target rect; if the same window is queued twice, the last one wins.
+        void SetTarget(HWND window, const RECT& rect);
+
+        CommitResult Commit();
+
+        // Forget what was committed for a window (eg someone else moved it), so the
+        // next target is applied even if it matches.
+        void Invalidate(HWND window);
+        void InvalidateAll();
+
+        CommitResult GetLastCommitResult() const;
+        CommitResult GetTotals() const;
+
+    private:
+        struct Entry
+        {
+            HWND window;
+            RECT rect;
+        };
+
+        static Entry* Find(std::vector<Entry>& entries, HWND window);
+
+        DeferredGeometryBackend m_defaultBackend{};
+        GeometryBackend& m_backend;
+
+        std::vector<Entry> m_pending;
+        std::vector<Entry> m_committed;
+        std::vector<Entry> m_changes;
+
+        CommitResult m_lastResult{};
+        CommitResult m_totals{};
+    };
+}